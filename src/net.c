@@ -0,0 +1,470 @@
+/*
+ * File:	net.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Routines shared by the netindex and netclust programs.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+/* edge weight comparison function for qsort() - similarities, best first */
+int CmpBySimilarity(const void *pt_a, const void *pt_b)
+{
+    const IDX_EDGE *pt_ea = (const IDX_EDGE *) pt_a;
+    const IDX_EDGE *pt_eb = (const IDX_EDGE *) pt_b;
+
+    return (pt_ea->weight < pt_eb->weight) - (pt_ea->weight > pt_eb->weight);
+}
+
+/* edge weight comparison function for qsort() - distances, best first */
+int CmpByDistance(const void *pt_a, const void *pt_b)
+{
+    const IDX_EDGE *pt_ea = (const IDX_EDGE *) pt_a;
+    const IDX_EDGE *pt_eb = (const IDX_EDGE *) pt_b;
+
+    return (pt_ea->weight > pt_eb->weight) - (pt_ea->weight < pt_eb->weight);
+}
+
+/* float comparison functions for qsort() */
+int CmpAscending(const void *pt_a, const void *pt_b)
+{
+    const float a = *(const float *) pt_a;
+    const float b = *(const float *) pt_b;
+
+    return (a > b) - (a < b);
+}
+
+int CmpDescending(const void *pt_a, const void *pt_b)
+{
+    return CmpAscending(pt_b, pt_a);
+}
+
+/* edge comparison function for qsort() - node indices, source first */
+int CmpByNodes(const void *pt_a, const void *pt_b)
+{
+    const IDX_EDGE *pt_ea = (const IDX_EDGE *) pt_a;
+    const IDX_EDGE *pt_eb = (const IDX_EDGE *) pt_b;
+
+    if (pt_ea->nodeA != pt_eb->nodeA)
+	return (pt_ea->nodeA > pt_eb->nodeA) - (pt_ea->nodeA < pt_eb->nodeA);
+
+    return (pt_ea->nodeB > pt_eb->nodeB) - (pt_ea->nodeB < pt_eb->nodeB);
+}
+
+/* merge the sets of two nodes (union by size with path halving) */
+unsigned int UnionNodes(unsigned int *set, unsigned int *set_size,
+			unsigned int nodeA, unsigned int nodeB)
+{
+    unsigned int j, k;
+
+    for (j = nodeA; j != set[j]; j = set[j])
+	set[j] = set[set[j]];
+
+    for (k = nodeB; k != set[k]; k = set[k])
+	set[k] = set[set[k]];
+
+    if (j == k)
+	return 0;
+
+    if (set_size[j] < set_size[k]) {
+	set[j] = k;
+	set_size[k] += set_size[j];
+    } else {
+	set[k] = j;
+	set_size[j] += set_size[k];
+    }
+    return 1;
+}
+
+/* find the root of a node while other threads modify the sets */
+unsigned int FindRootAtomic(unsigned int *set, unsigned int node)
+{
+    volatile unsigned int *vset = set;
+    unsigned int parent, grand_parent;
+
+    /* path halving with compare-and-swap; a lost race is harmless */
+    while ((parent = vset[node]) != node) {
+	grand_parent = vset[parent];
+	__sync_bool_compare_and_swap(&set[node], parent, grand_parent);
+	node = grand_parent;
+    }
+    return node;
+}
+
+/* merge the sets of two nodes from several threads (lock-free) */
+unsigned int UnionNodesAtomic(unsigned int *set, unsigned int nodeA,
+			      unsigned int nodeB)
+{
+    unsigned int j, k, tmp;
+
+    for (;;) {
+	j = FindRootAtomic(set, nodeA);
+	k = FindRootAtomic(set, nodeB);
+
+	if (j == k)
+	    return 0;
+
+	/*
+	 * Always link the root with the higher index below the lower one so
+	 * that parents precede children and no cycles can be formed.
+	 */
+	if (j < k) {
+	    tmp = j;
+	    j = k;
+	    k = tmp;
+	}
+
+	if (__sync_bool_compare_and_swap(&set[j], j, k))
+	    return 1;
+
+	/* root j was linked by another thread, retry from the roots */
+	nodeA = j;
+	nodeB = k;
+    }
+}
+
+/* get the elapsed time (s) of a monotonic clock */
+double GetWallTime()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* get the user & system time (s) of all threads of the process */
+double GetCpuTime()
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/* get the bytes read & written by system calls (zero if not available) */
+void GetIoBytes(unsigned long long *bytes_read,
+		unsigned long long *bytes_written)
+{
+    char line[LINE_BUF];
+    FILE *fp;
+
+    *bytes_read = 0;
+    *bytes_written = 0;
+
+    if ((fp = fopen("/proc/self/io", "r")) == NULL)
+	return;
+
+    while (fgets(line, LINE_BUF, fp) != NULL) {
+	if (!strncmp(line, "rchar:", 6))
+	    *bytes_read = strtoull(line + 6, NULL, 10);
+	else if (!strncmp(line, "wchar:", 6))
+	    *bytes_written = strtoull(line + 6, NULL, 10);
+    }
+    fclose(fp);
+}
+
+/* get the peak resident set size (kB) of the process */
+unsigned long long GetPeakRss()
+{
+    struct rusage ru;
+
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_maxrss;
+}
+
+/* start an empty log of phases */
+void InitPhaseLog(PHASE_LOG * log)
+{
+    log->n_phases = 0;
+    BeginPhase(log);
+}
+
+/* mark the begin of a phase (a NULL log is ignored) */
+void BeginPhase(PHASE_LOG * log)
+{
+    if (log == NULL)
+	return;
+
+    log->wall_start = GetWallTime();
+    log->cpu_start = GetCpuTime();
+    GetIoBytes(&log->read_start, &log->write_start);
+}
+
+/* record the resources used since the begin of a phase */
+void EndPhase(PHASE_LOG * log, char *name, unsigned long long n_edges,
+	      unsigned long long bytes_mapped)
+{
+    unsigned long long bytes_read, bytes_written;
+    RUN_PHASE *phase;
+
+    if (log == NULL || log->n_phases == MAX_PHASES)
+	return;
+
+    phase = &log->phase[log->n_phases++];
+    GetIoBytes(&bytes_read, &bytes_written);
+
+    strncpy(phase->name, name, PHASE_NAME - 1);
+    phase->name[PHASE_NAME - 1] = '\0';
+    phase->wall_time = GetWallTime() - log->wall_start;
+    phase->cpu_time = GetCpuTime() - log->cpu_start;
+    phase->bytes_read = bytes_read - log->read_start + bytes_mapped;
+    phase->bytes_written = bytes_written - log->write_start;
+    phase->n_edges = n_edges;
+    phase->peak_rss = GetPeakRss();
+
+    /* the next phase starts here */
+    BeginPhase(log);
+}
+
+/* write a table of the phases into a text log */
+void WritePhaseLog(FILE * fp, PHASE_LOG * log)
+{
+    unsigned int i;
+    RUN_PHASE *phase;
+
+    fputs(" Phase         Wall[s]     CPU[s]   Read[MB] Written[MB]"
+	  "      Edges/s PeakRSS[MB]\n", fp);
+
+    for (i = 0; i < log->n_phases; i++) {
+	phase = &log->phase[i];
+	fprintf(fp, " %-10s %10.3f %10.3f %10.1f %11.1f", phase->name,
+		phase->wall_time, phase->cpu_time,
+		phase->bytes_read / 1048576.0,
+		phase->bytes_written / 1048576.0);
+
+	if (phase->n_edges && phase->wall_time > 0)
+	    fprintf(fp, " %12.0f", phase->n_edges / phase->wall_time);
+	else
+	    fprintf(fp, " %12s", "-");
+
+	fprintf(fp, " %11.1f\n", phase->peak_rss / 1024.0);
+    }
+    fputs("\n", fp);
+}
+
+/* write a string as a JSON string literal */
+void WriteJsonString(FILE * fp, char *str)
+{
+    fputc('"', fp);
+
+    for (; *str; str++) {
+	if (*str == '"' || *str == '\\')
+	    fprintf(fp, "\\%c", *str);
+	else if ((unsigned char) *str < 0x20)
+	    fprintf(fp, "\\u%04x", (unsigned char) *str);
+	else
+	    fputc(*str, fp);
+    }
+
+    fputc('"', fp);
+}
+
+/* write the phases as the member "phases" of a JSON object */
+void WritePhaseJson(FILE * fp, PHASE_LOG * log)
+{
+    unsigned int i;
+    RUN_PHASE *phase;
+
+    fputs("  \"phases\": [", fp);
+
+    for (i = 0; i < log->n_phases; i++) {
+	phase = &log->phase[i];
+	fprintf(fp, "%s\n    {\"name\": ", i ? "," : "");
+	WriteJsonString(fp, phase->name);
+	fprintf(fp, ", \"wall_s\": %.6f, \"cpu_s\": %.6f, "
+		"\"bytes_read\": %llu, \"bytes_written\": %llu, "
+		"\"edges\": %llu, \"edges_per_s\": %.0f, "
+		"\"peak_rss_kb\": %llu}", phase->wall_time, phase->cpu_time,
+		phase->bytes_read, phase->bytes_written, phase->n_edges,
+		phase->wall_time > 0 ? phase->n_edges / phase->wall_time : 0,
+		phase->peak_rss);
+    }
+
+    fputs(log->n_phases ? "\n  ]\n" : "]\n", fp);
+}
+
+/* get the size of a regular file (0 for pipes & terminals) */
+unsigned long long GetStreamSize(FILE * fp)
+{
+    struct stat st;
+
+    if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode))
+	return st.st_size;
+
+    return 0;
+}
+
+/* reset the counters & start the reporter thread of a loop */
+void StartProgress(PROGRESS * progress, char *task)
+{
+    sigset_t mask;
+
+    progress->task = task;
+    progress->n_edges = 0;
+    progress->n_bytes = 0;
+    progress->n_nodes = 0;
+    progress->done = 0;
+    progress->start_time = GetWallTime();
+
+    /*
+     * SIGUSR1 is blocked in this thread & the threads it creates, so that it
+     * is taken by the reporter only; it stays blocked after the loop, where a
+     * late signal is left pending instead of terminating the process.
+     */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    if (pthread_create(&progress->thread, NULL, RunProgressReporter,
+		       progress))
+	OOPS("Error: pthread_create()\n");
+}
+
+/* print the counters, rate & estimated time left of a loop to stderr */
+void ReportProgress(PROGRESS * progress)
+{
+    unsigned long long n_edges, n_bytes;
+    double elapsed, fraction;
+
+    n_edges = progress->n_edges;
+    n_bytes = progress->n_bytes;
+    elapsed = GetWallTime() - progress->start_time;
+
+    fprintf(stderr, "%s: %llu edges", progress->task, n_edges);
+    if (n_bytes)
+	fprintf(stderr, ", %.1f MB", n_bytes / 1048576.0);
+    if (progress->n_nodes)
+	fprintf(stderr, ", %u nodes", progress->n_nodes);
+    fprintf(stderr, ", %.0f edges/s, %.0f s",
+	    elapsed > 0 ? n_edges / elapsed : 0, elapsed);
+
+    /* estimate the time left from the bytes or edges done so far */
+    fraction = 0;
+    if (progress->total_bytes)
+	fraction = (double) n_bytes / progress->total_bytes;
+    else if (progress->total_edges)
+	fraction = (double) n_edges / progress->total_edges;
+
+    if (fraction > 0 && fraction <= 1)
+	fprintf(stderr, " (%.1f%%, ETA %.0f s)", 100 * fraction,
+		elapsed * (1 - fraction) / fraction);
+    fputc('\n', stderr);
+}
+
+/* report the progress periodically & on SIGUSR1 until the loop is done */
+void *RunProgressReporter(void *pt_arg)
+{
+    PROGRESS *progress;
+    sigset_t mask;
+    struct timespec timeout;
+    int sig;
+
+    progress = (PROGRESS *) pt_arg;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    timeout.tv_sec = progress->interval ? progress->interval : 1;
+    timeout.tv_nsec = 0;
+
+    for (;;) {
+	sig = sigtimedwait(&mask, NULL, &timeout);
+
+	if (progress->done)
+	    break;
+
+	if (sig == SIGUSR1 || progress->interval)
+	    ReportProgress(progress);
+    }
+
+    return NULL;
+}
+
+/* stop the reporter thread of a loop */
+void StopProgress(PROGRESS * progress)
+{
+    progress->done = 1;
+    pthread_kill(progress->thread, SIGUSR1);
+
+    if (pthread_join(progress->thread, NULL))
+	OOPS("Error: pthread_join()\n");
+}
+
+/* init an empty queue of blocks */
+void InitBlockQueue(BLOCK_QUEUE * queue)
+{
+    queue->head = 0;
+    queue->n_blocks = 0;
+
+    if (pthread_mutex_init(&queue->lock, NULL)
+	|| pthread_cond_init(&queue->not_empty, NULL)
+	|| pthread_cond_init(&queue->not_full, NULL))
+	OOPS("Error: pthread_mutex_init()\n");
+}
+
+/* append a block to a queue, waits while the queue is full */
+void PushBlock(BLOCK_QUEUE * queue, void *block)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->n_blocks == QUEUE_MAX)
+	pthread_cond_wait(&queue->not_full, &queue->lock);
+
+    queue->blocks[(queue->head + queue->n_blocks++) % QUEUE_MAX] = block;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/* remove the first block of a queue, waits while the queue is empty */
+void *PopBlock(BLOCK_QUEUE * queue)
+{
+    void *block;
+
+    pthread_mutex_lock(&queue->lock);
+    while (!queue->n_blocks)
+	pthread_cond_wait(&queue->not_empty, &queue->lock);
+
+    block = queue->blocks[queue->head];
+    queue->head = (queue->head + 1) % QUEUE_MAX;
+    queue->n_blocks--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+
+    return block;
+}
+
+/* release the synchronization of a queue */
+void FreeBlockQueue(BLOCK_QUEUE * queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+}
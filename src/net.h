@@ -27,8 +27,17 @@
 #define	NET_H
 
 #define _FILE_OFFSET_BITS 64	/* large file support (LFS) */
+
+#include <stdio.h>
+#include <pthread.h>
+
 #define LINE_BUF 100		/* line buffer */
-#define NODE_BUF 30		/* node alias buffer */
+#define MAX_THREADS 256		/* maximum number of worker threads */
+#define MAX_PHASES 16		/* maximum number of phases timed per run */
+#define PHASE_NAME 16		/* length of phase names */
+#define PROGRESS_EDGES 4194304	/* edges merged between updates of the progress */
+#define PROGRESS_STEP 65536	/* edges indexed between updates of the progress */
+#define QUEUE_MAX 8		/* maximum number of blocks in a queue */
 #define OOPS(s) { perror(s); exit(EXIT_FAILURE); }	/* exit with error message */
 #define MALLOC(s, t) if (((s) = malloc(t)) == NULL) OOPS("Error: malloc()\n");	/* allocate memory */
 #define FOPEN(fp, fn, fm) if ((fp = fopen(fn, fm)) == NULL) OOPS(fn);
@@ -37,12 +46,16 @@
 /* typedefs */
 typedef struct _idx_edge_ IDX_EDGE;	/* indexed graph edge */
 typedef struct _edge_ EDGE;	/* graph edge */
+typedef struct _run_phase_ RUN_PHASE;	/* resources used by a phase of a run */
+typedef struct _phase_log_ PHASE_LOG;	/* resources used by the phases of a run */
+typedef struct _progress_ PROGRESS;	/* progress of a long loop */
+typedef struct _block_queue_ BLOCK_QUEUE;	/* blocks passed between threads */
 
 /* type declarations */
 struct _edge_ {
-    char nodeA[NODE_BUF];
-    char nodeB[NODE_BUF];
-    float weight;
+    char *nodeA;		/* label of node A */
+    char *nodeB;		/* label of node B */
+    float weight;		/* edge weight */
 };
 
 struct _idx_edge_ {
@@ -51,4 +64,93 @@ struct _idx_edge_ {
     float weight;		/* edge weight */
 };
 
+/*
+ * The times & bytes of a phase are the differences of the process totals at
+ * its begin & end, so the phases of a run must not overlap. Bytes are those
+ * passed to read/write system calls (/proc/self/io) plus the bytes of mapped
+ * files the phase has read.
+ */
+struct _run_phase_ {
+    char name[PHASE_NAME];	/* name of the phase */
+    double wall_time;		/* elapsed time (s) */
+    double cpu_time;		/* user & system time of all threads (s) */
+    unsigned long long bytes_read;	/* bytes read */
+    unsigned long long bytes_written;	/* bytes written */
+    unsigned long long n_edges;	/* number of edges processed (0 if none) */
+    unsigned long long peak_rss;	/* peak resident set size at the end (kB) */
+};
+
+struct _phase_log_ {
+    unsigned int n_phases;	/* number of phases ended */
+    double wall_start;		/* elapsed time at the begin of a phase */
+    double cpu_start;		/* CPU time at the begin of a phase */
+    unsigned long long read_start;	/* bytes read at the begin of a phase */
+    unsigned long long write_start;	/* bytes written at the begin of a phase */
+    RUN_PHASE phase[MAX_PHASES];	/* ended phases in order */
+};
+
+/*
+ * The loop updates the counters of its progress once per block of edges; a
+ * reporter thread prints them to stderr every few seconds (if enabled) and
+ * whenever the process gets SIGUSR1.
+ */
+struct _progress_ {
+    char *task;			/* name of the reported task */
+    unsigned int interval;	/* seconds between reports (0 - SIGUSR1 only) */
+    unsigned long long total_edges;	/* edges to process (0 if unknown) */
+    unsigned long long total_bytes;	/* bytes to consume (0 if unknown) */
+    volatile unsigned long long n_edges;	/* edges processed */
+    volatile unsigned long long n_bytes;	/* bytes consumed */
+    volatile unsigned int n_nodes;	/* nodes discovered */
+    volatile unsigned int done;	/* 1 if the loop has finished */
+    double start_time;		/* elapsed time at the start of the loop */
+    pthread_t thread;		/* reporter thread */
+};
+
+/*
+ * The stages of a pipeline pass blocks in bounded queues: a stage waits
+ * on an empty queue for its input & on a full queue for its output.
+ */
+struct _block_queue_ {
+    void *blocks[QUEUE_MAX];	/* queued blocks */
+    unsigned int head;		/* first queued block */
+    unsigned int n_blocks;	/* number of queued blocks */
+    pthread_mutex_t lock;	/* guards the queue */
+    pthread_cond_t not_empty;	/* signalled when a block is pushed */
+    pthread_cond_t not_full;	/* signalled when a block is popped */
+};
+
+/* function prototypes */
+extern int CmpBySimilarity(const void *, const void *);
+extern int CmpByDistance(const void *, const void *);
+extern int CmpByNodes(const void *, const void *);
+extern int CmpAscending(const void *, const void *);
+extern int CmpDescending(const void *, const void *);
+extern unsigned int UnionNodes(unsigned int *, unsigned int *, unsigned int,
+			       unsigned int);
+extern unsigned int FindRootAtomic(unsigned int *, unsigned int);
+extern unsigned int UnionNodesAtomic(unsigned int *, unsigned int,
+				     unsigned int);
+
+extern double GetWallTime();
+extern double GetCpuTime();
+extern void GetIoBytes(unsigned long long *, unsigned long long *);
+extern unsigned long long GetPeakRss();
+extern void InitPhaseLog(PHASE_LOG *);
+extern void BeginPhase(PHASE_LOG *);
+extern void EndPhase(PHASE_LOG *, char *, unsigned long long,
+		     unsigned long long);
+extern void WritePhaseLog(FILE *, PHASE_LOG *);
+extern void WriteJsonString(FILE *, char *);
+extern void WritePhaseJson(FILE *, PHASE_LOG *);
+extern unsigned long long GetStreamSize(FILE *);
+extern void StartProgress(PROGRESS *, char *);
+extern void ReportProgress(PROGRESS *);
+extern void *RunProgressReporter(void *);
+extern void StopProgress(PROGRESS *);
+extern void InitBlockQueue(BLOCK_QUEUE *);
+extern void PushBlock(BLOCK_QUEUE *, void *);
+extern void *PopBlock(BLOCK_QUEUE *);
+extern void FreeBlockQueue(BLOCK_QUEUE *);
+
 #endif				/* NET_H */
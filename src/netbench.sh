@@ -0,0 +1,83 @@
+#!/bin/sh
+#
+# File:		netbench.sh
+# Author:	Arnold Kuzniar
+# Date:		29-04-2008
+# Version:	1.0
+#
+###########################################################################
+# Copyright 2008 Arnold Kuzniar
+#
+# This file is part of netclust/netindex.
+#
+# netclust/netindex is free software: you can redistribute it and/or modify
+# it under the terms of the GNU Lesser Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# netclust/netindex is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU Lesser Public License for more details.
+#
+# You should have received a copy of the GNU Lesser Public License
+# along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+###########################################################################
+#
+# End-to-end benchmark of netindex & netclust on synthetic graphs of netgen.
+#
+# Usage:
+#  netbench.sh [EDGES ...]   (default 1e5 1e6 1e7)
+#
+# Environment:
+#  NETBENCH_DIR - directory of the generated graphs & indices (default /tmp)
+#  NETBENCH_KEEP - keep the generated files if set
+#  NETINDEX_OPTS, NETCLUST_OPTS, NETGEN_OPTS - extra options of the programs
+#
+# For each size, a graph of EDGES / 10 nodes is generated with a fixed seed,
+# indexed (netindex), then clustered at the middle cutoff S 500 & the clusters
+# written to a file (netclust F2). Throughput is given in edges per second.
+
+BIN=`dirname "$0"`
+DIR=${NETBENCH_DIR:-/tmp}
+SIZES=${*:-"1e5 1e6 1e7"}
+
+# time of a command in seconds (ns resolution)
+elapsed() {
+    START=`date +%s%N`
+    "$@" > /dev/null || { echo "netbench: $1 failed" >&2; exit 1; }
+    END=`date +%s%N`
+    echo "$START $END" | awk '{ printf "%.3f", ($2 - $1) / 1e9 }'
+}
+
+rate() {
+    echo "$1 $2" | awk '{ if ($2 > 0) printf "%.0f", $1 / $2; else print "-" }'
+}
+
+for BIN_NAME in netgen netindex netclust; do
+    if [ ! -x "$BIN/$BIN_NAME" ]; then
+	echo "netbench: $BIN/$BIN_NAME not found (run make)" >&2
+	exit 1
+    fi
+done
+
+printf "%-12s %-10s %10s %10s %10s %14s %14s %14s\n" \
+    Edges Nodes Gen[s] Index[s] Cluster[s] Index[e/s] Cluster[e/s] Total[e/s]
+
+for SIZE in $SIZES; do
+    EDGES=`echo $SIZE | awk '{ printf "%.0f", $1 }'`
+    NODES=`echo $EDGES | awk '{ n = $1 / 10; printf "%.0f", n < 2 ? 2 : n }'`
+    GRAPH="$DIR/netbench.$EDGES.tsv"
+
+    rm -f "$GRAPH" "$GRAPH".*
+    T_GEN=`elapsed "$BIN/netgen" $NETGEN_OPTS -n $NODES -e $EDGES "$GRAPH"` || exit 1
+    T_IDX=`elapsed "$BIN/netindex" $NETINDEX_OPTS "$GRAPH"` || exit 1
+    T_CLS=`elapsed "$BIN/netclust" $NETCLUST_OPTS "$GRAPH" F2 S 500` || exit 1
+    T_ALL=`echo "$T_IDX $T_CLS" | awk '{ printf "%.3f", $1 + $2 }'`
+
+    printf "%-12s %-10s %10s %10s %10s %14s %14s %14s\n" \
+	$EDGES $NODES $T_GEN $T_IDX $T_CLS \
+	`rate $EDGES $T_IDX` `rate $EDGES $T_CLS` `rate $EDGES $T_ALL`
+
+    [ -n "$NETBENCH_KEEP" ] || rm -f "$GRAPH" "$GRAPH".*
+done
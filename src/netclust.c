@@ -27,6 +27,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "netio.h"
+#include "netparse.h"
+#include "nethash.h"
 #include "netclust.h"
 
 /* print program usage */
@@ -39,7 +45,7 @@ void NclsUsage()
     printf
 	("****************************************************\n");
     printf
-        (" Author:\n\tArnold Kuzniar\n");
+	(" Author:\n\tArnold Kuzniar\n");
     printf
 	(" Last update:\n\tApr 2008\n");
     printf
@@ -47,7 +53,7 @@ void NclsUsage()
     printf
 	(" Usage:\n");
     printf
-	("       netclust [FILE] [OUTPUT MODE] [WEIGHT TYPE] [WEIGHT CUTOFF]\n\n");
+	("       netclust [OPTIONS] [FILE] [OUTPUT MODE] [WEIGHT TYPE] [WEIGHT CUTOFF]\n\n");
     printf
 	("       FILE (mandatory)         - input file of graph edges\n");
     printf
@@ -59,6 +65,33 @@ void NclsUsage()
 	("                                  range of values for S - [0..N] (default 0)\n");
     printf
 	("                                  range of values for D - [0..1] (default 1)\n\n");
+    printf(" Options:\n");
+    printf
+	("       -c CUTOFFS - sweep several cutoffs in a single pass, given as a list\n");
+    printf
+	("                    C1,C2,... or a range START:END:STEP (replaces WEIGHT CUTOFF)\n");
+    printf
+	("       -d SOCKET - keep the graph in memory & answer cutoff queries over\n");
+    printf
+	("            a Unix domain socket (FILE [WEIGHT TYPE] only, see netserve.c)\n");
+    printf
+	("       -j - write the log as JSON too (FILE.netclust.json)\n");
+    printf
+	("       -p SECONDS - report the progress to STDERR every SECONDS (it is\n");
+    printf
+	("            reported on the signal SIGUSR1 anyway)\n");
+    printf
+	("       -s - cluster the edges of FILE (text) without index files, FILE\n");
+    printf
+	("            '-' reads the edges from STDIN (implies -s)\n");
+    printf
+	("       -t THREADS - number of threads merging the edges (default 1)\n");
+    printf
+	("                    or parsing the input text (-s)\n");
+    printf
+	("       -u - merge only the edges added to the index since the union-find\n");
+    printf
+	("            snapshot of the cutoff (FILE.[S/D]_[CUTOFF].ufs), then update it\n\n");
 
     exit(EXIT_FAILURE);
 }
@@ -83,54 +116,145 @@ unsigned int FCLOSE(FILE *fp, char *file_name)
 /* read node indices into table from file */
 unsigned int StoreNodeIdx(NIDX_TABLE * table, NCLS_IO_SET * pt_ioset)
 {
-    unsigned int i, n_nodes, node_buffer_size;
-    FILE *fp;
-
-    /* open file for reading */
-    FOPEN(fp, pt_ioset->infile_nidx, "r");
+    /* map or read the index file at once */
+    OpenNidxTable(table, pt_ioset->infile_nidx);
 
-    /* read the file header & get the number of nodes */
-    if (fread(&n_nodes, sizeof(unsigned int), 1, fp) == 0)
-	OOPS(pt_ioset->infile_nidx);
-    
-    /* read the file header & get the node buffer size  */
-    if (fread(&node_buffer_size, sizeof(unsigned int), 1, fp) == 0)
-	OOPS(pt_ioset->infile_nidx);
-
-    /* allocate memory for the lookup table */
-    MALLOC(table->nodes, n_nodes * sizeof(unsigned char *));
+    return 0;
+}
 
-    for (i = 0; i < n_nodes; i++) {
-	MALLOC(table->nodes[i], node_buffer_size * sizeof(unsigned char));
+/* parse a list of cutoffs "C1,C2,..." or a range "START:END:STEP" */
+unsigned int ParseCutoffList(char *str, unsigned int weight_type,
+			     float **cutoffs)
+{
+    unsigned int i, n;
+    float start, end, step, *list;
+    char *tok, *tok_end;
 
-	/* read the file & fill-in the lookup table */
-	if (fread
-	    (table->nodes[i], node_buffer_size * sizeof(unsigned char), 1,
-	     fp) == 0)
-	    OOPS(pt_ioset->infile_nidx);
+    if (sscanf(str, "%f:%f:%f", &start, &end, &step) == 3) {
+	if (step <= 0 || end < start
+	    || (end - start) / step + 1e-4 >= NCLS_MAX_CUTOFFS)
+	    NclsUsage();
+	n = (unsigned int) ((end - start) / step + 1e-4) + 1;
+	MALLOC(list, sizeof(float) * n);
+
+	for (i = 0; i < n; i++)
+	    list[i] = start + i * step;
+    } else {
+	for (n = 1, tok = str; *tok != '\0'; tok++)
+	    if (*tok == ',')
+		n++;
+	MALLOC(list, sizeof(float) * n);
+
+	/* every item must be a number (empty items are not skipped) */
+	for (i = 0, tok = str; i < n; i++, tok = tok_end + 1) {
+	    list[i] = strtof(tok, &tok_end);
+	    if (tok_end == tok || (*tok_end != ',' && *tok_end != '\0'))
+		NclsUsage();
+	}
     }
 
-    /* update table size */
-    table->table_size = n_nodes;
-    
-    /* close the index file */
-    FCLOSE(fp, pt_ioset->infile_nidx);
+    /* validate cutoffs depending on weight type */
+    for (i = 0; i < n; i++)
+	if (!(list[i] >= 0) || (list[i] > 1 && weight_type == 1))
+	    NclsUsage();
 
-    return 0;
+    if (n == 0)
+	NclsUsage();
+
+    *cutoffs = list;
+    return n;
 }
 
 /* set I/O file names */
-NCLS_IO_SET NclsStoreIOset(int argc, char **args)
+NCLS_IO_SET NclsStoreIOset(int argc, char **argv)
 {
     unsigned int weight_type;
     unsigned int output_mode;
+    int opt;
     float weight_cutoff;
+    char *sweep;
+    char *server;
+    char *prefix;
+    char **args;
+    int n_threads;
+    int interval;
+    unsigned int stream;
+    unsigned int update;
+    unsigned int json;
     NCLS_IO_SET ioset, *pt_ioset;
 
     /* init variables */
     pt_ioset = &ioset;
     weight_type = 0;		/* 0 - similarity */
     output_mode = 0;		/* 0 - not specified */
+    sweep = NULL;
+    server = NULL;
+    n_threads = 1;
+    stream = 0;
+    update = 0;
+    json = 0;
+    interval = 0;
+
+    /* parse options */
+    while ((opt = getopt(argc, argv, "c:d:jp:st:u")) != -1) {
+	switch (opt) {
+	case 'c':
+	    sweep = optarg;
+	    break;
+	case 'd':
+	    if (strlen(optarg) >= BUF)
+		NclsUsage();
+	    server = optarg;
+	    break;
+	case 'j':
+	    json = 1;
+	    break;
+	case 'p':
+	    if ((interval = atoi(optarg)) < 1)
+		NclsUsage();
+	    break;
+	case 's':
+	    stream = 1;
+	    break;
+	case 't':
+	    if ((n_threads = atoi(optarg)) < 1 || n_threads > MAX_THREADS)
+		NclsUsage();
+	    break;
+	case 'u':
+	    update = 1;
+	    break;
+	default:
+	    NclsUsage();
+	}
+    }
+
+    /* shift the positional parameters so that FILE is args[1] */
+    args = argv + optind - 1;
+    argc -= optind - 1;
+
+    /* validate the number of positional parameters */
+    if (server != NULL) {
+	/* a server takes FILE [WEIGHT TYPE], the cutoffs come with queries */
+	if (argc < 2 || argc > 3 || sweep != NULL || stream || update
+	    || !strcmp(args[1], "-"))
+	    NclsUsage();
+	if (argc > 2 && !strcmp(args[2], "D"))
+	    weight_type = 1;
+	else if (argc > 2 && strcmp(args[2], "S"))
+	    NclsUsage();
+	argc = 2;
+    } else if (argc < 3 || argc > 5 || (sweep != NULL && argc > 4))
+	NclsUsage();
+
+    /* the standard input is always a stream of edges */
+    if (!strcmp(args[1], "-"))
+	stream = 1;
+
+    if ((stream || update) && sweep != NULL)
+	NclsUsage();
+
+    if (stream && update)
+	NclsUsage();
 
     /* parse output mode */
     if (argc > 2) {
@@ -163,22 +287,49 @@ NCLS_IO_SET NclsStoreIOset(int argc, char **args)
     } else
 	weight_cutoff = (weight_type == 0) ? 0 : 1;
 
+    /* parse cutoff sweep (optional) */
+    if (sweep != NULL)
+	pt_ioset->n_cutoffs =
+	    ParseCutoffList(sweep, weight_type, &pt_ioset->cutoffs);
+    else {
+	pt_ioset->n_cutoffs = 0;
+	pt_ioset->cutoffs = NULL;
+    }
+
     /* set IO_SET elements */
     strcpy(pt_ioset->infile, args[1]);
     pt_ioset->output_mode = output_mode;
     pt_ioset->weight_type = weight_type;
     pt_ioset->weight_cutoff = weight_cutoff;
+    pt_ioset->between_codes = 0;
+    pt_ioset->n_threads = n_threads;
+    pt_ioset->stream = stream;
+    pt_ioset->update = update;
+    pt_ioset->serve = server != NULL;
+    strcpy(pt_ioset->socket_file, server != NULL ? server : "");
+    pt_ioset->n_edges_resumed = 0;
+    pt_ioset->json = json;
+    pt_ioset->progress.interval = interval;
+
+    /* name the output files of the standard input after "stdin" */
+    prefix = strcmp(args[1], "-") ? args[1] : "stdin";
 
     sprintf(pt_ioset->infile_nidx, "%s.nidx", pt_ioset->infile);
     sprintf(pt_ioset->infile_eidx, "%s.eidx", pt_ioset->infile);
-    sprintf(pt_ioset->outfile_log, "%s.netclust.log", pt_ioset->infile);
+    sprintf(pt_ioset->outfile_log, "%s.netclust.log", prefix);
+    sprintf(pt_ioset->outfile_json, "%s.netclust.json", prefix);
+    sprintf(pt_ioset->file_ufs, "%s.%c_%g.ufs", pt_ioset->infile,
+	    weight_type ? 'D' : 'S', weight_cutoff);
 
     /* set output cluster file */
     if (output_mode == 3 || output_mode == 4)
-	sprintf(pt_ioset->outfile_clst, "%s.clst", pt_ioset->infile);
+	sprintf(pt_ioset->outfile_clst, "%s.clst", prefix);
     else
 	sprintf(pt_ioset->outfile_clst, "None [STDOUT]");
 
+    /* time the phases of the run from here */
+    InitPhaseLog(&pt_ioset->phases);
+
     return ioset;
 }
 
@@ -194,43 +345,117 @@ int CmpBySize(const void *pt_a, const void *pt_b)
 /* find clusters in a graph */
 PARTITION *GetGraphPartition(NIDX_TABLE * table, NCLS_IO_SET * pt_ioset)
 {
-    unsigned int weight_type, i, j, k, n_nodes, n_edges, n_edges_passed,
-	n_clusters, cls_size, cls_id, new_cls_id, mem_id, *set, *set_size,
-	*cls_conv;
-    float weight, weight_cutoff;
-    IDX_EDGE iedge, *pt_iedge;
+    unsigned long long i, m, n, n_edges_passed;
+    unsigned int weight_type, n_nodes, *set, *set_size;
+    float weight_cutoff;
+    IDX_EDGE *edges;
     PARTITION *par;
-    CLUSTER *cls;
-    FILE *fp;
+    EIDX_READER *reader;
 
     n_edges_passed = 0;
-    new_cls_id = 0;
-    cls_size = 0;
-    pt_iedge = &iedge;
+    weight_cutoff = pt_ioset->weight_cutoff;
+    weight_type = pt_ioset->weight_type;
 
     /* allocate memory for union sets and set sizes */
     n_nodes = table->table_size;
     MALLOC(set, sizeof(unsigned int) * n_nodes);
     MALLOC(set_size, sizeof(unsigned int) * n_nodes);
-    MALLOC(cls_conv, sizeof(unsigned int) * n_nodes);
 
     for (i = 0; i < n_nodes; i++) {
 	set[i] = i;
 	set_size[i] = 1;
-	cls_conv[i] = 0;
     }
-    FOPEN(fp, pt_ioset->infile_eidx, "rb");
 
-    if (fread(&n_edges, sizeof(unsigned int), 1, fp) == 0)
-	OOPS(pt_ioset->infile_eidx);
+    reader = OpenEidxReader(pt_ioset->infile_eidx);
+
+    /* resume from the union sets of an earlier run (optional) */
+    if (pt_ioset->update)
+	n_edges_passed =
+	    LoadUnionSnapshot(set, set_size, n_nodes, &reader, pt_ioset);
+
+    /* read only the edges up to the cutoff of a sorted index */
+    LimitEidxReader(reader, weight_type, weight_cutoff);
+    CheckCutoffCodes(reader, pt_ioset);
+    pt_ioset->progress.total_edges = reader->n_left;
+    pt_ioset->progress.total_bytes = 0;
+    StartProgress(&pt_ioset->progress, "Clustering");
+
+    /* merge the edges in several threads (optional) */
+    if (pt_ioset->n_threads > 1)
+	n_edges_passed += ParallelUnion(set, reader, pt_ioset);
 
-    for (i = n_edges; i != 0; i--) {
-	/* get indexed edge (nodes) */
-	if (fread(pt_iedge, sizeof(IDX_EDGE), 1, fp) == 0)
-	    OOPS(pt_ioset->infile_eidx);
-	weight = pt_iedge->weight;
-	weight_cutoff = pt_ioset->weight_cutoff;
-	weight_type = pt_ioset->weight_type;
+    /* get indexed edges (nodes) block by block, in slices for the progress */
+    else
+	while ((n = ReadEidxBlock(reader, &edges)) != 0) {
+	    for (i = 0; i < n; i += m) {
+		m = n - i < PROGRESS_EDGES ? n - i : PROGRESS_EDGES;
+		n_edges_passed += UnionEdges(set, set_size, edges + i, m,
+					     weight_type, weight_cutoff);
+		pt_ioset->progress.n_edges += m;
+	    }
+
+	    /* the edges failing the codes of the cutoff are read too */
+	    pt_ioset->progress.n_edges = reader->n_read;
+	}
+    StopProgress(&pt_ioset->progress);
+
+    /* save the union sets for the next run (optional) */
+    if (pt_ioset->update)
+	SaveUnionSnapshot(set, n_nodes, reader, n_edges_passed, pt_ioset);
+    EndPhase(&pt_ioset->phases, "union", reader->n_read,
+	     reader->bytes_mapped);
+    CloseEidxReader(reader);
+
+    free(set_size);
+
+    par = BuildGraphPartition(table, set, &pt_ioset->phases);
+
+    free(set);
+
+    pt_ioset->n_edges = n_edges_passed;
+
+    return par;
+}
+
+/*
+ * Warn of a cutoff between two codes of linearly quantized weights: the edges
+ * are filtered by their weights rounded to the codes, so that the edges near
+ * the cutoff may differ from those of the exact weights.
+ */
+void CheckCutoffCodes(EIDX_READER * reader, NCLS_IO_SET * pt_ioset)
+{
+    unsigned int code, n_codes;
+    float weight_cutoff;
+
+    pt_ioset->between_codes = 0;
+    if (reader->codes == NULL || reader->header.n_codes)
+	return;
+
+    weight_cutoff = pt_ioset->weight_cutoff;
+    n_codes = EIDX_CODES(reader->weight_width);
+    code = FindWeightCode(weight_cutoff, reader->codes, n_codes);
+    if (code == 0 || code == n_codes || reader->codes[code] == weight_cutoff)
+	return;
+
+    pt_ioset->between_codes = 1;
+    pt_ioset->cutoff_codes[0] = reader->codes[code - 1];
+    pt_ioset->cutoff_codes[1] = reader->codes[code];
+    fprintf(stderr,
+	    "Warning: cutoff %g is between the codes %g and %g of %s, edges are filtered by their rounded weights.\n",
+	    weight_cutoff, pt_ioset->cutoff_codes[0],
+	    pt_ioset->cutoff_codes[1], reader->file_name);
+}
+
+/* merge the edges passing a cutoff, returns the number of edges passed */
+unsigned long long UnionEdges(unsigned int *set, unsigned int *set_size,
+			      IDX_EDGE * edges, unsigned long long n_edges,
+			      unsigned int weight_type, float weight_cutoff)
+{
+    unsigned long long i, n_edges_passed;
+    float weight;
+
+    for (i = 0, n_edges_passed = 0; i < n_edges; i++) {
+	weight = edges[i].weight;
 
 	/* filter edges depending on weight type */
 	if ((weight_type && weight > weight_cutoff)
@@ -240,26 +465,228 @@ PARTITION *GetGraphPartition(NIDX_TABLE * table, NCLS_IO_SET * pt_ioset)
 	n_edges_passed++;
 
 	/* set union algorithm */
-	for (j = pt_iedge->nodeA; j != set[j]; j = set[j])
-	    set[j] = set[set[j]];
+	UnionNodes(set, set_size, edges[i].nodeA, edges[i].nodeB);
+    }
+
+    return n_edges_passed;
+}
+
+/* merge a range of edges (thread routine) */
+void *UnionEdgeRange(void *pt_arg)
+{
+    unsigned long long i;
+    unsigned int weight_type;
+    float weight, weight_cutoff;
+    IDX_EDGE *edges;
+    UNION_TASK *task;
+
+    task = (UNION_TASK *) pt_arg;
+    weight_type = task->pt_ioset->weight_type;
+    weight_cutoff = task->pt_ioset->weight_cutoff;
+    edges = task->edges;
 
-	for (k = pt_iedge->nodeB; k != set[k]; k = set[k])
-	    set[k] = set[set[k]];
+    for (i = 0; i < task->count; i++) {
+	weight = edges[i].weight;
 
-	if (j == k)
+	/* filter edges depending on weight type */
+	if ((weight_type && weight > weight_cutoff)
+	    || (!weight_type && weight < weight_cutoff))
 	    continue;
 
-	if (set_size[j] < set_size[k]) {
-	    set[j] = k;
-	    set_size[k] += set_size[j];
-	} else {
-	    set[k] = j;
-	    set_size[j] += set_size[k];
+	task->n_edges_passed++;
+	UnionNodesAtomic(task->set, edges[i].nodeA, edges[i].nodeB);
+    }
+
+    return NULL;
+}
+
+/* merge the edges by splitting each block of edges across threads */
+unsigned long long ParallelUnion(unsigned int *set, EIDX_READER * reader,
+				 NCLS_IO_SET * pt_ioset)
+{
+    unsigned long long n, n_edges_passed, first, next, start, slice;
+    unsigned int t, n_threads;
+    pthread_t thread[MAX_THREADS];
+    UNION_TASK task[MAX_THREADS];
+    IDX_EDGE *edges;
+
+    n_threads = pt_ioset->n_threads;
+    n_edges_passed = 0;
+
+    for (t = 0; t < n_threads; t++) {
+	task[t].set = set;
+	task[t].pt_ioset = pt_ioset;
+	task[t].n_edges_passed = 0;
+    }
+
+    /* a mapped index is a single block of all edges, merged in slices */
+    while ((n = ReadEidxBlock(reader, &edges)) != 0) {
+	for (start = 0; start < n; start += slice, edges += slice) {
+	    slice = (unsigned long long) PROGRESS_EDGES * n_threads;
+	    if (slice > n - start)
+		slice = n - start;
+
+	    /* assign each thread a contiguous range of edges */
+	    for (t = 0, first = 0; t < n_threads; t++, first = next) {
+		next = slice * (t + 1) / n_threads;
+		task[t].edges = edges + first;
+		task[t].count = next - first;
+
+		if (pthread_create
+		    (&thread[t], NULL, UnionEdgeRange, &task[t]))
+		    OOPS("Error: pthread_create()\n");
+	    }
+
+	    for (t = 0; t < n_threads; t++)
+		if (pthread_join(thread[t], NULL))
+		    OOPS("Error: pthread_join()\n");
+
+	    pt_ioset->progress.n_edges += slice;
 	}
+
+	/* the edges failing the codes of the cutoff are read too */
+	pt_ioset->progress.n_edges = reader->n_read;
     }
-    FCLOSE(fp, pt_ioset->infile_eidx);
 
-    free(set_size);
+    for (t = 0; t < n_threads; t++)
+	n_edges_passed += task[t].n_edges_passed;
+
+    return n_edges_passed;
+}
+
+/* load the union sets of a snapshot & skip the edges it has merged */
+unsigned long long LoadUnionSnapshot(unsigned int *set, unsigned int *set_size,
+				     unsigned int n_nodes,
+				     EIDX_READER ** reader,
+				     NCLS_IO_SET * pt_ioset)
+{
+    unsigned int i;
+    struct stat st;
+    UFS_HEADER header;
+    FILE *fp;
+
+    if (stat(pt_ioset->infile_eidx, &st) || !S_ISREG(st.st_mode))
+	ExitIndexError(pt_ioset->infile_eidx, "is not a regular file.");
+
+    /* the first run merges all edges */
+    if ((fp = fopen(pt_ioset->file_ufs, "rb")) == NULL)
+	return 0;
+
+    if (fread(&header, sizeof(UFS_HEADER), 1, fp) != 1
+	|| memcmp(header.magic, UFS_MAGIC, INDEX_MAGIC_SZ))
+	ExitIndexError(pt_ioset->file_ufs, "is not a union-find snapshot.");
+    CheckIndexVersion(pt_ioset->file_ufs, header.version, header.byte_order);
+
+    /* the index must hold the snapshot edges followed by new edges only */
+    if (header.weight_type != pt_ioset->weight_type
+	|| header.weight_cutoff != pt_ioset->weight_cutoff
+	|| header.n_nodes > n_nodes
+	|| header.n_edges > (*reader)->n_edges
+	|| header.eidx_size > (unsigned long long) st.st_size
+	|| header.eidx_hash != HashEidxTail(*reader, header.eidx_size)
+	|| SkipEidxEdges(*reader, header.n_edges)) {
+	fprintf(stderr, "Warning: %s is out of date, merging all edges.\n",
+		pt_ioset->file_ufs);
+	FCLOSE(fp, pt_ioset->file_ufs);
+
+	/* start again from the first edge */
+	CloseEidxReader(*reader);
+	*reader = OpenEidxReader(pt_ioset->infile_eidx);
+	return 0;
+    }
+
+    /* the nodes added since the snapshot are singletons */
+    if (header.n_nodes
+	&& fread(set, sizeof(unsigned int), header.n_nodes,
+		 fp) != header.n_nodes)
+	ExitIndexError(pt_ioset->file_ufs, "is truncated.");
+    FCLOSE(fp, pt_ioset->file_ufs);
+
+    for (i = 0; i < header.n_nodes; i++) {
+	if (set[i] >= header.n_nodes)
+	    ExitIndexError(pt_ioset->file_ufs, "is corrupted.");
+	set_size[i] = 0;
+    }
+
+    /* the sets are saved flat: each node points to its root */
+    for (i = 0; i < header.n_nodes; i++)
+	if (set[set[i]] != set[i])
+	    ExitIndexError(pt_ioset->file_ufs, "is corrupted.");
+
+    /* count the members of each root for union by size */
+    for (i = 0; i < header.n_nodes; i++)
+	set_size[set[i]]++;
+
+    pt_ioset->n_edges_resumed = header.n_edges_passed;
+
+    return header.n_edges_passed;
+}
+
+/* save the union sets after merging all edges of the index */
+void SaveUnionSnapshot(unsigned int *set, unsigned int n_nodes,
+		       EIDX_READER * reader, unsigned long long n_edges_passed,
+		       NCLS_IO_SET * pt_ioset)
+{
+    unsigned int i, j, k, root;
+    char file_name[BUF + 4];
+    struct stat st;
+    UFS_HEADER header;
+    FILE *fp;
+
+    if (stat(pt_ioset->infile_eidx, &st))
+	OOPS(pt_ioset->infile_eidx);
+
+    /* flatten the sets (the same partition), so that a load checks them */
+    for (i = 0; i < n_nodes; i++) {
+	for (root = i; set[root] != root; root = set[root]);
+	for (j = i; j != root; j = k) {
+	    k = set[j];
+	    set[j] = root;
+	}
+    }
+
+    memset(&header, 0, sizeof(UFS_HEADER));
+    memcpy(header.magic, UFS_MAGIC, INDEX_MAGIC_SZ);
+    header.version = INDEX_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.weight_type = pt_ioset->weight_type;
+    header.weight_cutoff = pt_ioset->weight_cutoff;
+    header.n_nodes = n_nodes;
+    header.n_edges = reader->n_edges;
+    header.n_edges_passed = n_edges_passed;
+    header.eidx_size = st.st_size;
+    header.eidx_hash = HashEidxTail(reader, st.st_size);
+
+    /* replace the snapshot only once it is complete */
+    sprintf(file_name, "%s.tmp", pt_ioset->file_ufs);
+    FOPEN(fp, file_name, "wb");
+
+    if (fwrite(&header, sizeof(UFS_HEADER), 1, fp) != 1
+	|| (n_nodes
+	    && fwrite(set, sizeof(unsigned int), n_nodes, fp) != n_nodes))
+	OOPS(file_name);
+
+    FCLOSE(fp, file_name);
+
+    if (rename(file_name, pt_ioset->file_ufs))
+	OOPS(pt_ioset->file_ufs);
+}
+
+/* turn the union sets into clusters sorted by size (or NULL if out of memory) */
+PARTITION *NewGraphPartition(unsigned int n_nodes, unsigned int *set,
+			     PHASE_LOG * phases)
+{
+    unsigned int i, n_clusters, cls_id, new_cls_id, *cls_conv, *members;
+    PARTITION *par;
+    CLUSTER *cls;
+
+    new_cls_id = 0;
+    if ((cls_conv = malloc(sizeof(unsigned int) * (n_nodes ? n_nodes : 1)))
+	== NULL)
+	return NULL;
+
+    for (i = 0; i < n_nodes; i++)
+	cls_conv[i] = 0;
 
     /* post-process sets by finding nodes' roots */
     for (i = 0; i < n_nodes; i++) {
@@ -274,7 +701,7 @@ PARTITION *GetGraphPartition(NIDX_TABLE * table, NCLS_IO_SET * pt_ioset)
 	/* assign new clusterIDs */
 	if (!cls_conv[cls_id]) {
 	    new_cls_id++;
-	    cls_conv[cls_id] = new_cls_id;	/* start clusterID with one */
+	    cls_conv[cls_id] = new_cls_id;      /* start clusterID with one */
 	}
     }
 
@@ -282,7 +709,17 @@ PARTITION *GetGraphPartition(NIDX_TABLE * table, NCLS_IO_SET * pt_ioset)
     n_clusters = new_cls_id;
 
     /* init CLUSTER structure */
-    MALLOC(cls, sizeof(CLUSTER) * n_clusters);
+    cls = malloc(sizeof(CLUSTER) * (n_clusters ? n_clusters : 1));
+    members = malloc(sizeof(unsigned int) * (n_nodes ? n_nodes : 1));
+    par = malloc(sizeof(PARTITION));
+
+    if (cls == NULL || members == NULL || par == NULL) {
+	free(cls_conv);
+	free(cls);
+	free(members);
+	free(par);
+	return NULL;
+    }
 
     for (i = 0; i < n_clusters; i++) {
 	cls[i].id = 0;
@@ -293,42 +730,320 @@ PARTITION *GetGraphPartition(NIDX_TABLE * table, NCLS_IO_SET * pt_ioset)
     for (i = 0; i < n_nodes; i++)
 	cls[cls_conv[set[i]] - 1].size++;
 
-    /* store cluster members */
+    /* point each cluster to its range of a single array of members */
+    for (i = 0, cls_id = 0; i < n_clusters; i++) {
+	cls[i].member = members + cls_id;
+	cls_id += cls[i].size;
+    }
+
+    /* store cluster members (counting sort of nodes by cluster) */
     for (i = 0; i < n_nodes; i++) {
 	cls_id = cls_conv[set[i]] - 1;
-	cls_size = cls[cls_id].size;
-
-	if (!cls[cls_id].id) {
-	    MALLOC(cls[cls_id].member, sizeof(unsigned char *) * cls_size);
-
-	    for (j = 0; j < cls_size; j++)
-		MALLOC(cls[cls_id].member[j],
-		       sizeof(unsigned char) * NODE_BUF);
-
-	    cls[cls_id].id = 1;
-	}
-
-	mem_id = cls[cls_id].id - 1;
-	sprintf((char *) cls[cls_id].member[mem_id], "%s",
-		(char *) table->nodes[i]);
-	cls[cls_id].id++;
+	cls[cls_id].member[cls[cls_id].id++] = i;
     }
-    
-    free(set);
+
     free(cls_conv);
+    EndPhase(phases, "roots", 0, 0);
 
     /* sort clusters by size */
     qsort(cls, n_clusters, sizeof(CLUSTER), CmpBySize);
+    EndPhase(phases, "qsort", 0, 0);
 
-    MALLOC(par, sizeof(PARTITION));
     par->size = n_clusters;
     par->cluster = cls;
+    par->members = members;
+    par->table = NULL;
+
+    return par;
+}
+
+/* turn the union sets into clusters sorted by size */
+PARTITION *BuildGraphPartition(NIDX_TABLE * table, unsigned int *set,
+			       PHASE_LOG * phases)
+{
+    PARTITION *par;
+
+    if ((par = NewGraphPartition(table->table_size, set, phases)) == NULL)
+	OOPS("Error: malloc()\n");
+    par->table = table;
+
+    return par;
+}
+
+/* release memory of a graph partition */
+void FreeGraphPartition(PARTITION * par)
+{
+    free(par->members);
+    free(par->cluster);
+    free(par);
+}
+
+/* find clusters in a graph read from a text file of edges (no index files) */
+PARTITION *StreamGraphPartition(HASH_TABLE * pt_hash, NIDX_TABLE * table,
+				NCLS_IO_SET * pt_ioset)
+{
+    unsigned long long n_edges, n_edges_passed, n_bytes;
+    unsigned int i, j, n_chunks, n_nodes, max_nodes, node_a, node_b,
+	is_new, weight_type, *set, *set_size;
+    float weight, weight_cutoff;
+    size_t size;
+    char *text;
+    EDGE *pt_edge;
+    PARTITION *par;
+    TEXT_READER *reader;
+    TEXT_CHUNK chunks[MAX_THREADS];
+
+    n_edges = 0;
+    n_edges_passed = 0;
+    n_bytes = 0;
+    n_nodes = 0;
+    max_nodes = 1024;
+    MALLOC(set, sizeof(unsigned int) * max_nodes);
+    MALLOC(set_size, sizeof(unsigned int) * max_nodes);
+
+    weight_type = pt_ioset->weight_type;
+    weight_cutoff = pt_ioset->weight_cutoff;
+
+    /*
+     * The parsers keep all edges (the default cutoff of netindex), so that the
+     * nodes of the edges failing the cutoff are singletons as in the index.
+     */
+    for (i = 0; i < pt_ioset->n_threads; i++) {
+	chunks[i].weight_type = weight_type;
+	chunks[i].weight_cutoff = weight_type ? 1 : 0;
+	chunks[i].max_edges = 0;
+	chunks[i].edges = NULL;
+    }
+
+    /* read the input in blocks of lines parsed by several threads */
+    reader = OpenTextReader(pt_ioset->infile);
+    pt_ioset->progress.total_edges = 0;
+    pt_ioset->progress.total_bytes = GetStreamSize(reader->fp);
+    StartProgress(&pt_ioset->progress, "Clustering");
+    StartTextReader(reader);
+
+    while ((size = ReadTextBlock(reader, &text)) != 0) {
+	n_chunks = SplitTextBlock(text, size, chunks, pt_ioset->n_threads);
+	ParseTextChunks(chunks, n_chunks);
+
+	/* number the nodes & merge the edges in input order */
+	for (i = 0; i < n_chunks; i++) {
+	    switch (chunks[i].status) {
+	    case PARSE_FORMAT:
+		fputs("Error: Input file format is incorrect!\n", stderr);
+		exit(EXIT_FAILURE);
+	    case PARSE_RANGE:
+		if (pt_ioset->weight_type)
+		    fputs
+			("Input error: Edge weighes (distances) out of range.\n",
+			 stderr);
+		else
+		    fputs
+			("Input error: Edge weights (similarities) cannot have negative values.\n",
+			 stderr);
+		exit(EXIT_FAILURE);
+	    }
+
+	    n_edges += chunks[i].n_lines;
+	    for (j = 0; j < chunks[i].n_edges; j++) {
+		pt_edge = &chunks[i].edges[j];
+
+		/* update the progress every few edges (bytes in proportion) */
+		if (j % PROGRESS_STEP == 0) {
+		    pt_ioset->progress.n_edges = n_edges -
+			chunks[i].n_lines + j;
+		    pt_ioset->progress.n_bytes = n_bytes +
+			(chunks[i].text - text) +
+			chunks[i].size * j / chunks[i].n_edges;
+		    pt_ioset->progress.n_nodes = n_nodes;
+		}
+
+		node_a = AddHashKey(pt_hash, pt_edge->nodeA, &is_new);
+		node_b = AddHashKey(pt_hash, pt_edge->nodeB, &is_new);
+
+		/* add the new nodes to the union sets */
+		if (pt_hash->n_keys > max_nodes) {
+		    max_nodes *= 2;
+		    if ((set = realloc(set, sizeof(unsigned int) *
+				       max_nodes)) == NULL
+			|| (set_size = realloc(set_size,
+					       sizeof(unsigned int) *
+					       max_nodes)) == NULL)
+			OOPS("Error: realloc()\n");
+		}
+
+		for (; n_nodes < pt_hash->n_keys; n_nodes++) {
+		    set[n_nodes] = n_nodes;
+		    set_size[n_nodes] = 1;
+		}
+
+		/* filter edges depending on weight type */
+		weight = pt_edge->weight;
+		if ((weight_type && weight > weight_cutoff)
+		    || (!weight_type && weight < weight_cutoff))
+		    continue;
+
+		n_edges_passed++;
+		UnionNodes(set, set_size, node_a, node_b);
+	    }
+	}
+
+	n_bytes += size;
+    }
+    StopProgress(&pt_ioset->progress);
+    EndPhase(&pt_ioset->phases, "stream", n_edges, 0);
+    CloseTextReader(reader);
+
+    for (i = 0; i < pt_ioset->n_threads; i++)
+	free(chunks[i].edges);
+
+    /* look the node labels up in the key arena of the dictionary */
+    table->table_size = n_nodes;
+    table->node_buffer_size = NIDX_VARLEN;
+    table->labels = pt_hash->arena;
+    table->offsets = pt_hash->offsets;
+    table->data = NULL;
+    table->data_size = 0;
+    table->mapped = 0;
+
+    free(set_size);
+    par = BuildGraphPartition(table, set, &pt_ioset->phases);
+    free(set);
 
     pt_ioset->n_edges = n_edges_passed;
 
     return par;
 }
 
+/* find clusters in a graph for several cutoffs in a single pass */
+unsigned int SweepGraphPartition(NIDX_TABLE * table, NCLS_IO_SET * pt_ioset)
+{
+    unsigned long long i, n, n_edges_passed, n_edges_kept, max_edges, e,
+	first;
+    unsigned int weight_type, sorted, n_nodes, n_phases, *set, *set_size;
+    float weight, weight_cutoff;
+    IDX_EDGE *edges, *block;
+    PARTITION *par;
+    EIDX_READER *reader;
+
+    weight_type = pt_ioset->weight_type;
+    n_edges_kept = 0;
+    n_edges_passed = 0;
+    max_edges = 1024;
+
+    /* order cutoffs from the most to the least stringent */
+    qsort(pt_ioset->cutoffs, pt_ioset->n_cutoffs, sizeof(float),
+	  weight_type ? CmpAscending : CmpDescending);
+
+    /* keep edges that pass the least stringent cutoff */
+    weight_cutoff = pt_ioset->cutoffs[pt_ioset->n_cutoffs - 1];
+    MALLOC(edges, sizeof(IDX_EDGE) * max_edges);
+    reader = OpenEidxReader(pt_ioset->infile_eidx);
+    LimitEidxReader(reader, weight_type, weight_cutoff);
+    /* the edges within a compressed frame are ordered by node indices */
+    sorted = (reader->header.flags & EIDX_SORTED)
+	&& !(reader->header.flags & EIDX_COMPRESSED)
+	&& reader->header.weight_type == weight_type;
+
+    while ((n = ReadEidxBlock(reader, &block)) != 0) {
+	for (i = 0; i < n; i++) {
+	    weight = block[i].weight;
+
+	    if ((weight_type && weight > weight_cutoff)
+		|| (!weight_type && weight < weight_cutoff))
+		continue;
+
+	    if (n_edges_kept == max_edges) {
+		max_edges *= 2;
+		if ((edges =
+		     realloc(edges, sizeof(IDX_EDGE) * max_edges)) == NULL)
+		    OOPS("Error: realloc()\n");
+	    }
+	    edges[n_edges_kept++] = block[i];
+	}
+    }
+    EndPhase(&pt_ioset->phases, "read", reader->n_read,
+	     reader->bytes_mapped);
+
+    /* order edges from the best to the worst weight (unless indexed so) */
+    if (!sorted)
+	qsort(edges, n_edges_kept, sizeof(IDX_EDGE),
+	      weight_type ? CmpByDistance : CmpBySimilarity);
+    EndPhase(&pt_ioset->phases, "order", sorted ? 0 : n_edges_kept, 0);
+
+    /* the log of each cutoff holds the phases above & its own phases */
+    n_phases = pt_ioset->phases.n_phases;
+
+    /* allocate memory for union sets and set sizes */
+    n_nodes = table->table_size;
+    MALLOC(set, sizeof(unsigned int) * n_nodes);
+    MALLOC(set_size, sizeof(unsigned int) * n_nodes);
+
+    for (i = 0; i < n_nodes; i++) {
+	set[i] = i;
+	set_size[i] = 1;
+    }
+
+    /* grow the union sets incrementally & report each cutoff */
+    for (i = 0, e = 0; i < pt_ioset->n_cutoffs; i++) {
+	weight_cutoff = pt_ioset->cutoffs[i];
+	pt_ioset->phases.n_phases = n_phases;
+	first = e;
+
+	for (; e < n_edges_kept; e++) {
+	    weight = edges[e].weight;
+
+	    if ((weight_type && weight > weight_cutoff)
+		|| (!weight_type && weight < weight_cutoff))
+		break;
+
+	    n_edges_passed++;
+	    UnionNodes(set, set_size, edges[e].nodeA, edges[e].nodeB);
+	}
+
+	EndPhase(&pt_ioset->phases, "union", e - first, 0);
+	par = BuildGraphPartition(table, set, &pt_ioset->phases);
+
+	/* set per-cutoff output files */
+	pt_ioset->weight_cutoff = weight_cutoff;
+	pt_ioset->n_edges = n_edges_passed;
+	CheckCutoffCodes(reader, pt_ioset);
+	if (snprintf(pt_ioset->outfile_log, BUF, "%s.%c_%g.netclust.log",
+		     pt_ioset->infile, weight_type ? 'D' : 'S',
+		     weight_cutoff) >= BUF
+	    || snprintf(pt_ioset->outfile_json, BUF, "%s.%c_%g.netclust.json",
+			pt_ioset->infile, weight_type ? 'D' : 'S',
+			weight_cutoff) >= BUF
+	    || (pt_ioset->output_mode > 2
+		&& snprintf(pt_ioset->outfile_clst, BUF, "%s.%c_%g.clst",
+			    pt_ioset->infile, weight_type ? 'D' : 'S',
+			    weight_cutoff) >= BUF)) {
+	    fputs("Error: Output file name too long.\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+
+	if (pt_ioset->output_mode <= 2)
+	    printf("# WeightCutoff\t%f\n", weight_cutoff);
+
+	OutputGraphPartition(par, pt_ioset);
+	EndPhase(&pt_ioset->phases, "output", 0, 0);
+	NclsWriteLogFile(pt_ioset);
+	if (pt_ioset->json)
+	    NclsWriteJsonLog(pt_ioset);
+	FreeGraphPartition(par);
+
+	/* writing the logs is not part of the next cutoff */
+	BeginPhase(&pt_ioset->phases);
+    }
+
+    CloseEidxReader(reader);
+    free(edges);
+    free(set);
+    free(set_size);
+
+    return pt_ioset->n_cutoffs;
+}
+
 /* find the root of a node */
 unsigned int FindRoot(unsigned int *set, unsigned int node)
 {
@@ -343,6 +1058,7 @@ unsigned int OutputGraphPartition(PARTITION * par, NCLS_IO_SET * pt_ioset)
 {
     unsigned int i, j, sz, mode, n_nodes, n_clusters;
     CLUSTER *cls;
+    NIDX_TABLE *table;
     FILE *fp;
 
     fp = NULL;
@@ -350,6 +1066,7 @@ unsigned int OutputGraphPartition(PARTITION * par, NCLS_IO_SET * pt_ioset)
     n_clusters = 0;		/* number of non-singleton clusters */
     mode = pt_ioset->output_mode;
     cls = par->cluster;
+    table = par->table;
 
     /* open cluster file for writing only if output mode is 3 (F1) or 4 (F2) */
     if (mode > 2)
@@ -370,16 +1087,18 @@ unsigned int OutputGraphPartition(PARTITION * par, NCLS_IO_SET * pt_ioset)
 	for (j = 0; j < sz; j++) {
 	    switch (mode) {
 	    case 1:
-		printf("%d\t%s\n", i + 1, cls[i].member[j]);
+		printf("%d\t%s\n", i + 1,
+		       NODE_LABEL(table, cls[i].member[j]));
 		break;
 	    case 2:
-		printf("%s ", cls[i].member[j]);
+		printf("%s ", NODE_LABEL(table, cls[i].member[j]));
 		break;
 	    case 3:
-		fprintf(fp, "%d\t%s\n", i + 1, cls[i].member[j]);
+		fprintf(fp, "%d\t%s\n", i + 1,
+			NODE_LABEL(table, cls[i].member[j]));
 		break;
 	    case 4:
-		fprintf(fp, "%s ", cls[i].member[j]);
+		fprintf(fp, "%s ", NODE_LABEL(table, cls[i].member[j]));
 		break;
 	    default:
 		fprintf(stderr, "Error:Output mode not supported.");
@@ -427,10 +1146,46 @@ void NclsWriteLogFile(NCLS_IO_SET * pt_ioset)
 	fputs(" WeightType\t\tDistance\n", fp);
 
     fprintf(fp, " WeightCutoff\t\t%f\n", pt_ioset->weight_cutoff);
+    if (pt_ioset->between_codes)
+	fprintf(fp, " CutoffBetweenCodes\t%f %f\n", pt_ioset->cutoff_codes[0],
+		pt_ioset->cutoff_codes[1]);
     fprintf(fp, " NumNodes\t\t%d\n", pt_ioset->n_nodes);
-    fprintf(fp, " NumEdges\t\t%d\n", pt_ioset->n_edges);
+    fprintf(fp, " NumEdges\t\t%llu\n", pt_ioset->n_edges);
+    if (pt_ioset->update)
+	fprintf(fp, " NumEdgesResumed\t%llu\n", pt_ioset->n_edges_resumed);
     fprintf(fp, " NumClusters\t\t%d\n\n", pt_ioset->n_clusters);
+    WritePhaseLog(fp, &pt_ioset->phases);
 
     /* close log file */
     FCLOSE(fp, pt_ioset->outfile_log);
 }
+
+/* write clustering summary & phases into a JSON log file */
+void NclsWriteJsonLog(NCLS_IO_SET * pt_ioset)
+{
+    FILE *fp;
+
+    FOPEN(fp, pt_ioset->outfile_json, "w");
+
+    fputs("{\n  \"program\": \"netclust\",\n  \"input_file\": ", fp);
+    WriteJsonString(fp, pt_ioset->infile);
+    fputs(",\n  \"output_clst_file\": ", fp);
+    WriteJsonString(fp, pt_ioset->outfile_clst);
+    fprintf(fp, ",\n  \"weight_type\": \"%s\",\n",
+	    pt_ioset->weight_type ? "distance" : "similarity");
+    fprintf(fp, "  \"weight_cutoff\": %f,\n", pt_ioset->weight_cutoff);
+    if (pt_ioset->between_codes)
+	fprintf(fp, "  \"cutoff_between_codes\": [%f, %f],\n",
+		pt_ioset->cutoff_codes[0], pt_ioset->cutoff_codes[1]);
+    fprintf(fp, "  \"threads\": %u,\n", pt_ioset->n_threads);
+    fprintf(fp, "  \"num_nodes\": %u,\n", pt_ioset->n_nodes);
+    fprintf(fp, "  \"num_edges\": %llu,\n", pt_ioset->n_edges);
+    if (pt_ioset->update)
+	fprintf(fp, "  \"num_edges_resumed\": %llu,\n",
+		pt_ioset->n_edges_resumed);
+    fprintf(fp, "  \"num_clusters\": %u,\n", pt_ioset->n_clusters);
+    WritePhaseJson(fp, &pt_ioset->phases);
+    fputs("}\n", fp);
+
+    FCLOSE(fp, pt_ioset->outfile_json);
+}
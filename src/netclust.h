@@ -26,52 +26,95 @@
 #ifndef NETCLUST_H
 #define	NETCLUST_H
 #define BUF 255
+#define NCLS_MAX_CUTOFFS 1000000	/* maximum number of cutoffs of a sweep */
 
 /* typedefs */
 typedef struct _ncls_io_set_ NCLS_IO_SET;	/* IO settings */
-typedef struct _nidx_table_ NIDX_TABLE;	/* lookup table of node aliases */
 typedef struct _cluster_ CLUSTER;	/* cluster members */
 typedef struct _partition_ PARTITION;	/* graph partition i.e union of clusters */
+typedef struct _union_task_ UNION_TASK;	/* range of edges merged by a thread */
 
 /* type declarations */
 struct _ncls_io_set_ {
     unsigned int output_mode;	/* output mode for clusters */
     unsigned int weight_type;	/* weight type for edges */
     unsigned int n_nodes;	/* number of nodes */
-    unsigned int n_edges;	/* number of edges */
+    unsigned long long n_edges;	/* number of edges */
     unsigned int n_clusters;	/* number of clusters */
+    unsigned int n_cutoffs;	/* number of cutoffs to sweep */
+    unsigned int n_threads;	/* number of threads merging edges */
+    unsigned int stream;	/* 1 if edges are read from the input text */
+    unsigned int update;	/* 1 if union sets are resumed from a snapshot */
+    unsigned int serve;		/* 1 if queries are answered over a socket */
+    unsigned int json;		/* 1 if a JSON log is written too */
+    unsigned long long n_edges_resumed;	/* number of edges merged by the snapshot */
     float weight_cutoff;	/* cutoff value for edge weights */
+    unsigned int between_codes;	/* 1 if the cutoff is between linear codes */
+    float cutoff_codes[2];	/* weights of the codes around the cutoff */
+    float *cutoffs;		/* cutoff values to sweep */
     char infile[BUF];		/* input file of graph edges */
     char infile_nidx[BUF];	/* input file of node indices */
     char infile_eidx[BUF];	/* input file of indexed edges */
     char outfile_clst[BUF];	/* output file of clusters */
     char outfile_log[BUF];	/* output log file */
-};
-
-struct _nidx_table_ {
-    unsigned int table_size;	/* size of the lookup table */
-    unsigned char **nodes;	/* an array of node aliases */
+    char file_ufs[BUF];		/* union-find snapshot file */
+    char socket_file[BUF];	/* Unix domain socket of the server */
+    char outfile_json[BUF];	/* output JSON log file */
+    PHASE_LOG phases;		/* resources used by the phases of the run */
+    PROGRESS progress;		/* progress of the loop over the edges */
 };
 
 struct _cluster_ {
     unsigned int id;		/* cluster ID */
     unsigned int size;		/* cluster size */
-    unsigned char **member;	/* array of cluster members */
+    unsigned int *member;	/* node indices of cluster members */
 };
 
 struct _partition_ {
     unsigned int size;		/* number of clusters */
     CLUSTER *cluster;		/* array of clusters */
+    unsigned int *members;	/* node indices grouped by cluster */
+    NIDX_TABLE *table;		/* lookup table of node labels */
+};
+
+struct _union_task_ {
+    unsigned int *set;		/* union sets shared by all threads */
+    unsigned long long count;	/* number of edges */
+    unsigned long long n_edges_passed;	/* number of edges passing the cutoff */
+    IDX_EDGE *edges;		/* edges merged by the thread */
+    NCLS_IO_SET *pt_ioset;	/* IO settings */
 };
 
 /* function prototypes */
 extern void NclsUsage();
 extern NCLS_IO_SET NclsStoreIOset(int, char **);
 extern unsigned int StoreNodeIdx(NIDX_TABLE *, NCLS_IO_SET *);
+extern unsigned int ParseCutoffList(char *, unsigned int, float **);
 extern int CmpBySize(const void *, const void *);
 extern PARTITION *GetGraphPartition(NIDX_TABLE *, NCLS_IO_SET *);
+extern void CheckCutoffCodes(EIDX_READER *, NCLS_IO_SET *);
+extern unsigned long long UnionEdges(unsigned int *, unsigned int *,
+				     IDX_EDGE *, unsigned long long,
+				     unsigned int, float);
+extern void *UnionEdgeRange(void *);
+extern unsigned long long ParallelUnion(unsigned int *, EIDX_READER *,
+				       NCLS_IO_SET *);
+extern unsigned long long LoadUnionSnapshot(unsigned int *, unsigned int *,
+					    unsigned int, EIDX_READER **,
+					    NCLS_IO_SET *);
+extern void SaveUnionSnapshot(unsigned int *, unsigned int, EIDX_READER *,
+			      unsigned long long, NCLS_IO_SET *);
+extern PARTITION *NewGraphPartition(unsigned int, unsigned int *,
+				    PHASE_LOG *);
+extern PARTITION *BuildGraphPartition(NIDX_TABLE *, unsigned int *,
+				      PHASE_LOG *);
+extern void FreeGraphPartition(PARTITION *);
+extern PARTITION *StreamGraphPartition(HASH_TABLE *, NIDX_TABLE *,
+				       NCLS_IO_SET *);
+extern unsigned int SweepGraphPartition(NIDX_TABLE *, NCLS_IO_SET *);
 extern unsigned int FindRoot(unsigned int *, unsigned int);
 extern unsigned int OutputGraphPartition(PARTITION *, NCLS_IO_SET *);
 extern void NclsWriteLogFile(NCLS_IO_SET *);
+extern void NclsWriteJsonLog(NCLS_IO_SET *);
 
 #endif				/* NETCLUST_H */
@@ -53,17 +53,56 @@
  *  WEIGHT TYPE - edge weights might refer to either similarity (S) or distance (D) measure (default S)
  *  WEIGHT CUTOFF - cutoff value for edge weights
  *
+ *  -c CUTOFFS - sweep a list (C1,C2,...) or a range (START:END:STEP) of cutoffs in a
+ *      single pass over the edges; clusters and logs are written per cutoff into
+ *      FILE.[S|D]_[CUTOFF].clst and FILE.[S|D]_[CUTOFF].netclust.log
+ *
+ *  -d SOCKET - load the indices of FILE once & answer queries over a Unix
+ *      domain socket until SIGINT/SIGTERM; FILE [WEIGHT TYPE] are the only
+ *      positional parameters, the cutoff comes with each query (one per line):
+ *
+ *         COUNT [CUTOFF]             -> OK [number of clusters]
+ *         CLUSTER [CUTOFF] [NODE]    -> OK [cluster] [cluster size]
+ *         MEMBERS [CUTOFF] [CLUSTER] -> OK [cluster size] [members]
+ *
+ *      the partitions of the recently used cutoffs are cached
+ *
+ *  -j - write the log as JSON too (*.netclust.json, next to each log file)
+ *
+ *  -p SECONDS - print the edges merged, rate & estimated time left to STDERR
+ *      every SECONDS; they are printed on SIGUSR1 in any case
+ *
+ *  -s - read the edges from FILE (text, see netindex) instead of the index files;
+ *      the nodes are numbered & the edges merged as they are read. FILE '-' is
+ *      the standard input (implies -s), e.g. zcat FILE.gz | netclust - O1 S 500;
+ *      its output files are named stdin.clst and stdin.netclust.log
+ *
+ *  -t THREADS - merge the edges in several threads using a lock-free union-find;
+ *      the resulting clusters are identical to those of a single thread
+ *      (with -s, the input text is parsed by several threads)
+ *
+ *  -u - keep the union sets of the cutoff in a snapshot (FILE.[S|D]_[CUTOFF].ufs);
+ *      the next run loads them & merges only the edges appended to the index
+ *      since (netindex -a), then updates the snapshot. A snapshot of another
+ *      index is detected & all edges are merged again
+ *
  *  Note:
  *   The netclust program does not process the input FILE per se, but it uses two binary files
  *   (*.nidx and *.eidx) derived by indexing of the input FILE. Clusters are written into an
- *   output file (*.clst) only if F1/F2 output modes are selected. A log file (*.netindex.log)
- *   is written for each netclust run.
+ *   output file (*.clst) only if F1/F2 output modes are selected. A log file (*.netclust.log)
+ *   is written for each netclust run, with the wall & CPU time, bytes read & written,
+ *   throughput & peak memory of each phase (node index, union of edges, roots, sorting
+ *   of clusters, output).
  */
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include "net.h"
+#include "netio.h"
+#include "nethash.h"
 #include "netclust.h"
+#include "netserve.h"
 
 int main(int argc, char **argv)
 {
@@ -71,28 +110,52 @@ int main(int argc, char **argv)
     PARTITION *par;
     NCLS_IO_SET ioset, *pt_ioset;
     NIDX_TABLE table, *pt_table;
+    HASH_TABLE *pt_hash;
 
     pt_ioset = &ioset;
     pt_table = &table;
 
     /* validate the number of input args */
-    if (argc < 3 || argc > 5)
+    if (argc < 3)
 	NclsUsage();
 
     /* store IO parameters */
     ioset = NclsStoreIOset(argc, argv);
 
-    /* store node indices into lookup table */
-    StoreNodeIdx(pt_table, pt_ioset);
-    
-    /* retrieve all graph clusters (partition) */
-    par = GetGraphPartition(pt_table, pt_ioset);
+    /* cluster the input text without index files (optional) */
+    if (pt_ioset->stream) {
+	pt_hash = NewHashTable(HASH_TABLE_SZ);
+	par = StreamGraphPartition(pt_hash, pt_table, pt_ioset);
+    } else {
+	/* store node indices into lookup table */
+	StoreNodeIdx(pt_table, pt_ioset);
+	EndPhase(&pt_ioset->phases, "nidx", 0,
+		 pt_table->mapped ? pt_table->data_size : 0);
+
+	/* answer queries over a socket until interrupted (optional) */
+	if (pt_ioset->serve) {
+	    RunClusterServer(pt_table, pt_ioset);
+	    exit(EXIT_SUCCESS);
+	}
+
+	/* sweep several cutoffs (writes clusters & log files per cutoff) */
+	if (pt_ioset->n_cutoffs) {
+	    SweepGraphPartition(pt_table, pt_ioset);
+	    exit(EXIT_SUCCESS);
+	}
+
+	/* retrieve all graph clusters (partition) */
+	par = GetGraphPartition(pt_table, pt_ioset);
+    }
 
     /* output clusters */
     OutputGraphPartition(par, pt_ioset);
+    EndPhase(&pt_ioset->phases, "output", 0, 0);
 
-    /* write a log file */
+    /* write a log file (and a JSON log) */
     NclsWriteLogFile(pt_ioset);
+    if (pt_ioset->json)
+	NclsWriteJsonLog(pt_ioset);
 
     exit(EXIT_SUCCESS);
 }
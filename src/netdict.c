@@ -0,0 +1,316 @@
+/*
+ * File:	netdict.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Microbenchmark of the node dictionaries of netindex.
+ *
+ * A stream of inserts draws its keys at random from a set of distinct keys,
+ * so that most inserts find their key as most node labels of a graph recur.
+ * The stream is inserted into a single hash table by one thread, then into a
+ * concurrent dictionary split by consecutive slices among 1, 2, 4, ...
+ * threads; the provisional IDs are renumbered to dense IDs in stream order
+ * (as netindex numbers the nodes in edge order) & checked against the keys.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "nethash.h"
+#include "netdict.h"
+
+/* print program usage */
+void NdictUsage()
+{
+    printf
+	("**************************************************\n");
+    printf
+	(" netdict v1.0 - benchmark of node dictionaries\n");
+    printf
+	("**************************************************\n");
+    printf
+	(" Description:\n\tThe program times the inserts of keys into the node dictionary of\n\t'netindex' by a single thread & into the concurrent dictionary by\n\tseveral threads.\n");
+    printf
+	(" Usage:\n");
+    printf("       netdict [OPTIONS]\n\n");
+    printf(" Options:\n");
+    printf
+	("       -k KEYS - number of distinct keys (default 1000000)\n");
+    printf
+	("       -l LENGTH - length of the keys (default 12)\n");
+    printf
+	("       -n INSERTS - number of inserts (default 10 * KEYS, e.g. 1e8)\n");
+    printf
+	("       -s SHARDS - shards of the concurrent dictionary (default %u)\n",
+	 HASH_SHARDS);
+    printf
+	("       -t THREADS - maximum number of threads (default 8)\n\n");
+
+    exit(EXIT_FAILURE);
+}
+
+/* set benchmark settings */
+NDICT_SET NdictStoreSet(int argc, char **argv)
+{
+    int opt, n_shards, n_threads;
+    unsigned int n_digits;
+    double n_keys, n_inserts, n;
+    NDICT_SET set;
+
+    /* init variables */
+    n_keys = 1000000;
+    n_inserts = 0;
+    n_shards = HASH_SHARDS;
+    n_threads = 8;
+    set.label_len = 12;
+
+    /* parse options (counts may be given as 1e9) */
+    while ((opt = getopt(argc, argv, "k:l:n:s:t:")) != -1) {
+	switch (opt) {
+	case 'k':
+	    n_keys = atof(optarg);
+	    break;
+	case 'l':
+	    set.label_len = atoi(optarg);
+	    break;
+	case 'n':
+	    n_inserts = atof(optarg);
+	    break;
+	case 's':
+	    n_shards = atoi(optarg);
+	    break;
+	case 't':
+	    n_threads = atoi(optarg);
+	    break;
+	default:
+	    NdictUsage();
+	}
+    }
+
+    /* the keys are "n" followed by the zero-padded key number */
+    for (n_digits = 1, n = 10; n < n_keys; n_digits++, n *= 10);
+
+    /* validate the settings */
+    if (optind != argc || n_keys < 1 || n_keys > 4294967295.0
+	|| n_inserts < 0 || n_inserts > 4294967295.0
+	|| set.label_len < n_digits + 1
+	|| set.label_len > NDICT_MAX_LABEL || n_shards < 1
+	|| n_shards > 65536 || n_threads < 1 || n_threads > MAX_THREADS)
+	NdictUsage();
+
+    set.n_keys = (unsigned int) n_keys;
+    set.n_inserts = n_inserts ? (unsigned long long) n_inserts :
+	10ULL * set.n_keys;
+    if (set.n_inserts > 4294967295ULL)
+	NdictUsage();
+    set.n_shards = n_shards;
+    set.max_threads = n_threads;
+
+    return set;
+}
+
+/* generate the keys & draw the key of each insert */
+void GenerateKeys(NDICT_SET * set)
+{
+    unsigned long long i, z;
+
+    MALLOC(set->labels, (size_t) set->n_keys * (set->label_len + 1));
+    MALLOC(set->keys, set->n_inserts * sizeof(unsigned int));
+    MALLOC(set->ids, set->n_inserts * sizeof(unsigned int));
+    MALLOC(set->dense, set->n_keys * sizeof(unsigned int));
+
+    for (i = 0; i < set->n_keys; i++)
+	sprintf(set->labels + i * (set->label_len + 1), "n%0*llu",
+		set->label_len - 1, i);
+
+    /* splitmix64 of the insert number */
+    for (i = 0; i < set->n_inserts; i++) {
+	z = (i + 1) * 0x9e3779b97f4a7c15ULL;
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	set->keys[i] = (unsigned int) ((z ^ (z >> 31)) % set->n_keys);
+    }
+}
+
+/* insert the keys into a single hash table, returns the time */
+double InsertHashKeys(NDICT_SET * set)
+{
+    unsigned long long i;
+    unsigned int is_new;
+    double start;
+    HASH_TABLE *table;
+
+    table = NewHashTable(HASH_TABLE_SZ);
+
+    start = GetWallTime();
+    for (i = 0; i < set->n_inserts; i++)
+	AddHashKey(table, set->labels +
+		   (size_t) set->keys[i] * (set->label_len + 1), &is_new);
+    start = GetWallTime() - start;
+
+    set->n_distinct = table->n_keys;
+    FreeHashTable(table);
+
+    return start;
+}
+
+/* insert a slice of the keys into the concurrent dictionary (thread routine) */
+void *InsertShardKeys(void *arg)
+{
+    unsigned long long i;
+    unsigned int is_new;
+    NDICT_JOB *job;
+    NDICT_SET *set;
+
+    job = (NDICT_JOB *) arg;
+    set = job->set;
+
+    for (i = job->first; i < job->last; i++)
+	set->ids[i] = AddShardKey(job->table, set->labels +
+				  (size_t) set->keys[i] *
+				  (set->label_len + 1), &is_new);
+
+    return NULL;
+}
+
+/* renumber the provisional IDs in insert order & check them, returns the time */
+double RenumberShardKeys(NDICT_SET * set, SHARD_TABLE * table)
+{
+    unsigned long long i;
+    unsigned int is_new;
+    double start;
+    char *label;
+
+    /* each provisional ID must be that of its key */
+    for (i = 0; i < set->n_inserts; i++) {
+	label = set->labels + (size_t) set->keys[i] * (set->label_len + 1);
+	if (strcmp(GetShardKey(table, set->ids[i]), label)) {
+	    fprintf(stderr, "Error: Wrong ID of key %s.\n", label);
+	    exit(EXIT_FAILURE);
+	}
+    }
+
+    start = GetWallTime();
+    for (i = 0; i < set->n_inserts; i++)
+	set->ids[i] = GetDenseId(table, set->ids[i], &is_new);
+    start = GetWallTime() - start;
+
+    /* the dense IDs & the keys must correspond one to one */
+    if (table->n_keys != set->n_distinct) {
+	fprintf(stderr, "Error: %u dense IDs of %u keys.\n", table->n_keys,
+		set->n_distinct);
+	exit(EXIT_FAILURE);
+    }
+    memset(set->dense, 0, set->n_keys * sizeof(unsigned int));
+    for (i = 0; i < set->n_inserts; i++) {
+	if (set->ids[i] >= set->n_keys
+	    || (set->dense[set->ids[i]]
+		&& set->dense[set->ids[i]] != set->keys[i] + 1)) {
+	    fprintf(stderr, "Error: Dense ID %u of two keys.\n",
+		    set->ids[i]);
+	    exit(EXIT_FAILURE);
+	}
+	set->dense[set->ids[i]] = set->keys[i] + 1;
+    }
+
+    return start;
+}
+
+/*
+ * insert the keys into a concurrent dictionary by a number of threads,
+ * returns the time of the inserts & that of the renumbering
+ */
+double BenchShardTable(NDICT_SET * set, unsigned int n_threads,
+		       double *pt_renumber)
+{
+    unsigned int i;
+    double start;
+    pthread_t thread[MAX_THREADS];
+    NDICT_JOB jobs[MAX_THREADS];
+    SHARD_TABLE *table;
+
+    table = NewShardTable(set->n_shards, HASH_TABLE_SZ);
+
+    for (i = 0; i < n_threads; i++) {
+	jobs[i].set = set;
+	jobs[i].table = table;
+	jobs[i].first = set->n_inserts * i / n_threads;
+	jobs[i].last = set->n_inserts * (i + 1) / n_threads;
+    }
+
+    start = GetWallTime();
+    if (n_threads == 1)
+	InsertShardKeys(&jobs[0]);
+    else {
+	for (i = 0; i < n_threads; i++)
+	    if (pthread_create(&thread[i], NULL, InsertShardKeys, &jobs[i]))
+		OOPS("Error: pthread_create()\n");
+	for (i = 0; i < n_threads; i++)
+	    if (pthread_join(thread[i], NULL))
+		OOPS("Error: pthread_join()\n");
+    }
+    start = GetWallTime() - start;
+
+    *pt_renumber = RenumberShardKeys(set, table);
+    FreeShardTable(table);
+
+    return start;
+}
+
+/* time the dictionaries & print a table of the inserts per second */
+void RunDictBenchmark(NDICT_SET * set)
+{
+    unsigned int n_threads;
+    double seconds, renumber, base;
+
+    printf("netdict: %u keys of %u bytes, %llu inserts, %u shards, %ld CPUs\n",
+	   set->n_keys, set->label_len, set->n_inserts, set->n_shards,
+	   sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%-10s %8s %12s %14s %10s %12s\n", "Dictionary", "Threads",
+	   "Insert[s]", "Inserts/s", "Speedup", "Renumber[s]");
+
+    seconds = InsertHashKeys(set);
+    printf("%-10s %8u %12.3f %14.0f %10s %12s\n", "hash", 1, seconds,
+	   set->n_inserts / seconds, "-", "-");
+
+    /* 1, 2, 4, ... threads & the maximum */
+    base = 0;
+    for (n_threads = 1; n_threads <= set->max_threads;
+	 n_threads = n_threads < set->max_threads
+	 && 2 * n_threads > set->max_threads ?
+	 set->max_threads : 2 * n_threads) {
+	seconds = BenchShardTable(set, n_threads, &renumber);
+	if (base == 0)
+	    base = seconds;
+	printf("%-10s %8u %12.3f %14.0f %10.2f %12.3f\n", "shards",
+	       n_threads, seconds, set->n_inserts / seconds, base / seconds,
+	       renumber);
+    }
+
+    free(set->labels);
+    free(set->keys);
+    free(set->ids);
+    free(set->dense);
+}
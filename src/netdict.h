@@ -0,0 +1,66 @@
+/*
+ * File:	netdict.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETDICT_H
+#define	NETDICT_H
+
+#define NDICT_MAX_LABEL 64	/* maximum length of node labels */
+
+/* typedefs */
+typedef struct _ndict_set_ NDICT_SET;	/* benchmark settings & keys */
+typedef struct _ndict_job_ NDICT_JOB;	/* inserts of a thread */
+
+/* type declarations */
+struct _ndict_set_ {
+    unsigned int n_keys;	/* number of distinct keys */
+    unsigned int n_distinct;	/* number of distinct keys inserted */
+    unsigned long long n_inserts;	/* number of inserts (keys drawn at random) */
+    unsigned int label_len;	/* length of the keys */
+    unsigned int n_shards;	/* shards of the concurrent dictionary */
+    unsigned int max_threads;	/* maximum number of inserting threads */
+    char *labels;		/* keys of label_len + 1 bytes each */
+    unsigned int *keys;		/* key of each insert */
+    unsigned int *ids;		/* provisional ID of each insert */
+    unsigned int *dense;	/* key + 1 of each dense ID (0 - none) */
+};
+
+struct _ndict_job_ {
+    NDICT_SET *set;		/* settings & keys */
+    SHARD_TABLE *table;		/* dictionary shared by the threads */
+    unsigned long long first;	/* first insert of the thread */
+    unsigned long long last;	/* end of the inserts of the thread */
+};
+
+/* function prototypes */
+extern void NdictUsage();
+extern NDICT_SET NdictStoreSet(int, char **);
+extern void GenerateKeys(NDICT_SET *);
+extern double InsertHashKeys(NDICT_SET *);
+extern void *InsertShardKeys(void *);
+extern double RenumberShardKeys(NDICT_SET *, SHARD_TABLE *);
+extern double BenchShardTable(NDICT_SET *, unsigned int, double *);
+extern void RunDictBenchmark(NDICT_SET *);
+
+#endif				/* NETDICT_H */
@@ -0,0 +1,61 @@
+/*
+ * File:	netdict_main.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Program description:
+ *  netdict is a microbenchmark of the node dictionary of netindex: it inserts
+ *  the same stream of keys into a single hash table & into the concurrent
+ *  dictionary (shards) by 1, 2, 4, ... threads, and prints the inserts per
+ *  second & the speedup of each number of threads.
+ *
+ * Inputs:
+ *  -k KEYS - number of distinct keys (default 1000000)
+ *  -l LENGTH - length of the keys (default 12)
+ *  -n INSERTS - number of inserts, keys drawn at random (default 10 * KEYS)
+ *  -s SHARDS - shards of the concurrent dictionary (default 64)
+ *  -t THREADS - maximum number of threads (default 8)
+ *
+ *  The dense IDs of each run are checked against the keys, so that a run fails
+ *  if two keys share an ID or a key gets two IDs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "net.h"
+#include "nethash.h"
+#include "netdict.h"
+
+int main(int argc, char **argv)
+{
+    NDICT_SET set;
+
+    /* store benchmark settings */
+    set = NdictStoreSet(argc, argv);
+
+    /* generate the keys & time the dictionaries */
+    GenerateKeys(&set);
+    RunDictBenchmark(&set);
+
+    exit(EXIT_SUCCESS);
+}
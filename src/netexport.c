@@ -0,0 +1,230 @@
+/*
+ * File:	netexport.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Export of an indexed graph as text.
+ *
+ * The edges of the edge index are written in the [nodeA] [nodeB] [weight]
+ * format of the input ("%s\t%s\t%f\n"), so that a graph indexed with a cutoff
+ * gives the same lines as the *.sube file of netindex -e (in the order of the
+ * edge index). Slices of edges are formatted by several threads & written by
+ * a writer thread in order.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "netio.h"
+#include "netparse.h"
+#include "netexport.h"
+
+/* print program usage */
+void NexpUsage()
+{
+    printf
+	("**************************************************\n");
+    printf
+	(" netexport v1.0 - graph (network) export program\n");
+    printf
+	("**************************************************\n");
+    printf
+	(" Description:\n\tThe program writes the edges of a graph indexed by 'netindex'\n\tas text (the subset of edges passing the cutoff of the index).\n");
+    printf
+	(" Usage:\n");
+    printf("       netexport [OPTIONS] [FILE]\n\n");
+    printf
+	("       FILE (mandatory)         - graph file indexed by 'netindex' (FILE.nidx & FILE.eidx)\n\n");
+    printf(" Options:\n");
+    printf
+	("       -o OUTFILE - output file of edges ('-' for STDOUT, default FILE.sube)\n");
+    printf
+	("       -t THREADS - number of threads formatting the edges (default 1)\n\n");
+
+    exit(EXIT_FAILURE);
+}
+
+/* set IO settings */
+NEXP_IO_SET NexpStoreIOset(int argc, char **argv)
+{
+    int opt, n_threads;
+    char *outfile;
+    NEXP_IO_SET ioset;
+
+    /* init variables */
+    n_threads = 1;
+    outfile = NULL;
+
+    /* parse options */
+    while ((opt = getopt(argc, argv, "o:t:")) != -1) {
+	switch (opt) {
+	case 'o':
+	    outfile = optarg;
+	    break;
+	case 't':
+	    if ((n_threads = atoi(optarg)) < 1 || n_threads > MAX_THREADS)
+		NexpUsage();
+	    break;
+	default:
+	    NexpUsage();
+	}
+    }
+
+    /* validate the input file name */
+    if (optind != argc - 1 || strlen(argv[optind]) + 6 > BUF
+	|| (outfile != NULL && strlen(outfile) >= BUF))
+	NexpUsage();
+
+    ioset.n_threads = n_threads;
+    ioset.n_edges = 0;
+    sprintf(ioset.infile_nidx, "%s.nidx", argv[optind]);
+    sprintf(ioset.infile_eidx, "%s.eidx", argv[optind]);
+    if (outfile != NULL)
+	strcpy(ioset.outfile, outfile);
+    else
+	sprintf(ioset.outfile, "%s.sube", argv[optind]);
+
+    return ioset;
+}
+
+/* format the edges of a chunk as lines of text (thread routine) */
+void *FormatEdgeChunk(void *pt_arg)
+{
+    unsigned int i;
+    size_t len_a, len_b;
+    char *label_a, *label_b;
+    NEXP_CHUNK *chunk;
+
+    chunk = (NEXP_CHUNK *) pt_arg;
+    chunk->size = 0;
+
+    for (i = 0; i < chunk->n_edges; i++) {
+	if (chunk->edges[i].nodeA >= chunk->table->table_size
+	    || chunk->edges[i].nodeB >= chunk->table->table_size)
+	    ExitIndexError(chunk->file_name, "is corrupted.");
+
+	label_a = NODE_LABEL(chunk->table, chunk->edges[i].nodeA);
+	label_b = NODE_LABEL(chunk->table, chunk->edges[i].nodeB);
+	len_a = strlen(label_a);
+	len_b = strlen(label_b);
+
+	/* room for the labels, two tabs, the weight & a newline */
+	if (chunk->size + len_a + len_b + LINE_BUF > chunk->max_size) {
+	    chunk->max_size = 2 * (chunk->size + len_a + len_b + LINE_BUF);
+	    if ((chunk->text = realloc(chunk->text, chunk->max_size)) == NULL)
+		OOPS("Error: realloc()\n");
+	}
+
+	memcpy(chunk->text + chunk->size, label_a, len_a);
+	chunk->size += len_a;
+	chunk->text[chunk->size++] = '\t';
+	memcpy(chunk->text + chunk->size, label_b, len_b);
+	chunk->size += len_b;
+	chunk->text[chunk->size++] = '\t';
+	chunk->size += FormatFixedWeight(chunk->text + chunk->size,
+					 chunk->edges[i].weight);
+	chunk->text[chunk->size++] = '\n';
+    }
+
+    return NULL;
+}
+
+/* write the edges of an indexed graph as text */
+void ExportEdges(NEXP_IO_SET * pt_ioset)
+{
+    unsigned long long n, start, n_slice;
+    unsigned int i, n_chunks;
+    IDX_EDGE *edges;
+    NIDX_TABLE table;
+    EIDX_READER *reader;
+    FILE_WRITER *writer;
+    NEXP_CHUNK chunks[MAX_THREADS];
+    pthread_t thread[MAX_THREADS];
+    FILE *fp;
+
+    OpenNidxTable(&table, pt_ioset->infile_nidx);
+    reader = OpenEidxReader(pt_ioset->infile_eidx);
+
+    if (!strcmp(pt_ioset->outfile, "-"))
+	fp = stdout;
+    else
+	FOPEN(fp, pt_ioset->outfile, "wb");
+    writer = OpenFileWriter(fp, pt_ioset->outfile, NULL);
+
+    for (i = 0; i < pt_ioset->n_threads; i++) {
+	chunks[i].table = &table;
+	chunks[i].file_name = pt_ioset->infile_eidx;
+	chunks[i].text = NULL;
+	chunks[i].max_size = 0;
+    }
+
+    /* format slices of each block of edges by several threads */
+    while ((n = ReadEidxBlock(reader, &edges)) != 0) {
+	for (start = 0; start < n; start += n_slice) {
+	    n_slice = n - start;
+	    if (n_slice > (unsigned long long) NEXP_SLICE *
+		pt_ioset->n_threads)
+		n_slice = (unsigned long long) NEXP_SLICE *
+		    pt_ioset->n_threads;
+
+	    /* an equal share of the slice for each thread */
+	    for (i = 0, n_chunks = 0; i < pt_ioset->n_threads; i++) {
+		chunks[i].edges = edges + start +
+		    n_slice * i / pt_ioset->n_threads;
+		chunks[i].n_edges = n_slice * (i + 1) / pt_ioset->n_threads -
+		    n_slice * i / pt_ioset->n_threads;
+		if (chunks[i].n_edges)
+		    n_chunks = i + 1;
+	    }
+
+	    if (n_chunks == 1)
+		FormatEdgeChunk(&chunks[0]);
+	    else {
+		for (i = 0; i < n_chunks; i++)
+		    if (pthread_create(&thread[i], NULL, FormatEdgeChunk,
+				       &chunks[i]))
+			OOPS("Error: pthread_create()\n");
+		for (i = 0; i < n_chunks; i++)
+		    if (pthread_join(thread[i], NULL))
+			OOPS("Error: pthread_join()\n");
+	    }
+
+	    /* the lines are written in the order of the index */
+	    for (i = 0; i < n_chunks; i++)
+		WriteFileBlock(writer, chunks[i].text, chunks[i].size);
+	}
+	pt_ioset->n_edges += n;
+    }
+
+    CloseFileWriter(writer);
+    if ((fp == stdout ? fflush(fp) : fclose(fp)) != 0)
+	OOPS(pt_ioset->outfile);
+
+    for (i = 0; i < pt_ioset->n_threads; i++)
+	free(chunks[i].text);
+    CloseEidxReader(reader);
+    CloseNidxTable(&table);
+}
@@ -0,0 +1,61 @@
+/*
+ * File:	netexport.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETEXPORT_H
+#define	NETEXPORT_H
+
+#define BUF 255			/* string buffer */
+#define NEXP_SLICE 1048576	/* edges formatted at once by each thread */
+
+/* typedefs */
+typedef struct _nexp_io_set_ NEXP_IO_SET;	/* IO settings */
+typedef struct _nexp_chunk_ NEXP_CHUNK;	/* edges formatted by a thread */
+
+/* type declarations */
+struct _nexp_io_set_ {
+    unsigned int n_threads;	/* number of formatting threads */
+    unsigned long long n_edges;	/* number of exported edges */
+    char infile_nidx[BUF];	/* node index */
+    char infile_eidx[BUF];	/* edge index */
+    char outfile[BUF];		/* output file of edges ("-" - STDOUT) */
+};
+
+struct _nexp_chunk_ {
+    NIDX_TABLE *table;		/* lookup table of node labels */
+    char *file_name;		/* edge index (for errors) */
+    IDX_EDGE *edges;		/* edges to format */
+    unsigned int n_edges;	/* number of edges */
+    char *text;			/* formatted lines */
+    size_t size;		/* size of the text */
+    size_t max_size;		/* allocated size of the text */
+};
+
+/* function prototypes */
+extern void NexpUsage();
+extern NEXP_IO_SET NexpStoreIOset(int, char **);
+extern void *FormatEdgeChunk(void *);
+extern void ExportEdges(NEXP_IO_SET *);
+
+#endif				/* NETEXPORT_H */
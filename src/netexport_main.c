@@ -0,0 +1,66 @@
+/*
+ * File:	netexport_main.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Program description:
+ *  netexport writes the edges of a graph indexed by netindex as text, i.e.
+ *  the subset of the input edges passing the cutoff of the index. It rebuilds
+ *  the *.sube file that netindex writes only with the -e option.
+ *
+ * Inputs:
+ *  FILE (mandatory) - graph file indexed by netindex (FILE.nidx & FILE.eidx)
+ *
+ *  -o OUTFILE - output file of edges, "-" for STDOUT (default FILE.sube)
+ *  -t THREADS - format the edges by several threads; the output is the same
+ *       as with a single thread
+ *
+ *  Output file:
+ *
+ *   *.sube - a text file of the indexed edges ("%s\t%s\t%f\n"), in the order
+ *       of the edge index (the input order unless it was sorted or reduced
+ *       to a spanning forest)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "net.h"
+#include "netio.h"
+#include "netexport.h"
+
+int main(int argc, char **argv)
+{
+    NEXP_IO_SET ioset;
+
+    /* validate the number of input parameters */
+    if (argc < 2)
+	NexpUsage();
+
+    /* store IO settings */
+    ioset = NexpStoreIOset(argc, argv);
+
+    /* write the edges */
+    ExportEdges(&ioset);
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,527 @@
+/*
+ * File:	netext.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * External-memory node dictionary of netindex (-m MEMORY).
+ *
+ * Graphs with more distinct labels than fit in memory are indexed in passes
+ * over temporary files next to the edge index, each within the budget:
+ *
+ *  1. the labels of the edges are collected with their positions (2 * edge
+ *     + 0 for node A, + 1 for node B) & written as sorted runs, the weights
+ *     in edge order;
+ *  2. the runs are merged (EXT_FANIN at a time); each distinct label gets the
+ *     next node index & is written into the node index, and the (position,
+ *     index) pairs of its references go to the bucket of their positions;
+ *  3. the buckets are read in turn into an array of node indices by position,
+ *     which is joined with the weights to write the edges in input order.
+ *
+ * Node indices follow the order of the labels (not of their first edges), so
+ * that the clusters are the same as with the in-memory dictionary.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "netio.h"
+#include "netext.h"
+
+/* open an empty dictionary with temporary files named after a prefix */
+EXT_DICT *OpenExtDict(char *prefix, unsigned long long memory)
+{
+    EXT_DICT *ext;
+
+    MALLOC(ext, sizeof(EXT_DICT));
+    ext->prefix = prefix;
+    ext->memory = memory;
+
+    /* half of the budget for the labels of a run, half for the references */
+    ext->max_arena = memory / 2;
+    ext->max_refs = memory / 2 / sizeof(EXT_REF);
+    MALLOC(ext->arena, ext->max_arena);
+    MALLOC(ext->refs, sizeof(EXT_REF) * ext->max_refs);
+    ext->arena_used = 0;
+    ext->n_refs = 0;
+    ext->n_runs = 0;
+    ext->first_run = 0;
+    ext->n_edges = 0;
+    ext->n_nodes = 0;
+
+    /* the node indices of a bucket of edge positions fit the budget */
+    ext->bucket_size = memory / sizeof(unsigned int);
+    if (ext->bucket_size > INT_MAX)
+	ext->bucket_size = INT_MAX;
+    ext->bucket_size -= ext->bucket_size % 2;
+    ext->blob_size = 0;
+
+    sprintf(ext->weights_name, "%s.weights.tmp", prefix);
+    FOPEN(ext->fp_weights, ext->weights_name, "w+b");
+    setvbuf(ext->fp_weights, NULL, _IOFBF, EXT_FILE_BUF);
+
+    return ext;
+}
+
+/* label comparison function for qsort(), by the keys of the labels first */
+int CmpExtRefs(const void *pt_a, const void *pt_b)
+{
+    const EXT_REF *pt_ra = (const EXT_REF *) pt_a;
+    const EXT_REF *pt_rb = (const EXT_REF *) pt_b;
+
+    if (pt_ra->key != pt_rb->key)
+	return pt_ra->key < pt_rb->key ? -1 : 1;
+
+    /* equal keys of labels shorter than 8 bytes are equal labels */
+    if (!(pt_ra->key & 0xff))
+	return 0;
+
+    return strcmp(pt_ra->label + 8, pt_rb->label + 8);
+}
+
+/* add a reference to a label, writes a run when the budget is used */
+void AddExtLabel(EXT_DICT * ext, char *label, unsigned long long pos)
+{
+    size_t size, i;
+    unsigned long long key;
+
+    size = strlen(label) + 1;
+    if (ext->arena_used + size > ext->max_arena
+	|| ext->n_refs == ext->max_refs) {
+	if (size > ext->max_arena) {
+	    fputs("Error: Node label longer than the memory budget.\n",
+		  stderr);
+	    exit(EXIT_FAILURE);
+	}
+	WriteExtRun(ext);
+    }
+
+    /* the key orders the labels as strcmp() does */
+    for (i = 0, key = 0; i < 8; i++)
+	key = key << 8 | (i < size ? (unsigned char) label[i] : 0);
+
+    memcpy(ext->arena + ext->arena_used, label, size);
+    ext->refs[ext->n_refs].key = key;
+    ext->refs[ext->n_refs].label = ext->arena + ext->arena_used;
+    ext->refs[ext->n_refs].pos = pos;
+    ext->arena_used += size;
+    ext->n_refs++;
+}
+
+/* add the labels & the weight of the next edge */
+void AddExtEdge(EXT_DICT * ext, EDGE * pt_edge)
+{
+    AddExtLabel(ext, pt_edge->nodeA, 2 * ext->n_edges);
+    AddExtLabel(ext, pt_edge->nodeB, 2 * ext->n_edges + 1);
+
+    if (fwrite(&pt_edge->weight, sizeof(float), 1, ext->fp_weights) != 1)
+	OOPS(ext->weights_name);
+    ext->n_edges++;
+}
+
+/* get the smallest budget (MB) for the buckets of the edges added so far */
+unsigned long long GetExtMinMemory(EXT_DICT * ext)
+{
+    unsigned long long bucket_size;
+
+    bucket_size = (2 * ext->n_edges + EXT_MAX_BUCKETS - 1) / EXT_MAX_BUCKETS;
+
+    return ((bucket_size * sizeof(unsigned int)) >> 20) + 1;
+}
+
+/* sort the references in memory & write them as a run */
+void WriteExtRun(EXT_DICT * ext)
+{
+    size_t i, j, k;
+    unsigned int len, n;
+    char file_name[EXT_NAME];
+    FILE *fp;
+
+    if (!ext->n_refs)
+	return;
+
+    qsort(ext->refs, ext->n_refs, sizeof(EXT_REF), CmpExtRefs);
+
+    sprintf(file_name, "%s.run%u.tmp", ext->prefix, ext->n_runs++);
+    FOPEN(fp, file_name, "wb");
+    setvbuf(fp, NULL, _IOFBF, EXT_FILE_BUF);
+
+    /* a group of references per label */
+    for (i = 0; i < ext->n_refs; i = j) {
+	for (j = i + 1; j < ext->n_refs
+	     && !CmpExtRefs(&ext->refs[j], &ext->refs[i]); j++);
+
+	len = strlen(ext->refs[i].label);
+	n = j - i;
+	if (fwrite(&len, sizeof(unsigned int), 1, fp) != 1
+	    || fwrite(ext->refs[i].label, 1, len, fp) != len
+	    || fwrite(&n, sizeof(unsigned int), 1, fp) != 1)
+	    OOPS(file_name);
+
+	for (k = i; k < j; k++)
+	    if (fwrite(&ext->refs[k].pos, sizeof(unsigned long long), 1,
+		       fp) != 1)
+		OOPS(file_name);
+    }
+
+    FCLOSE(fp, file_name);
+    ext->arena_used = 0;
+    ext->n_refs = 0;
+}
+
+/* open the i-th run for merging */
+void OpenExtRun(EXT_DICT * ext, EXT_RUN * run, unsigned int i,
+		size_t buf_size)
+{
+    sprintf(run->file_name, "%s.run%u.tmp", ext->prefix, i);
+    FOPEN(run->fp, run->file_name, "rb");
+    setvbuf(run->fp, NULL, _IOFBF, buf_size);
+    run->label = NULL;
+    run->len = 0;
+    run->max_len = 0;
+    run->n_refs = 0;
+}
+
+/* read the label of the next group of a run, returns zero at its end */
+unsigned int ReadExtGroup(EXT_RUN * run)
+{
+    unsigned int len;
+
+    if (fread(&len, sizeof(unsigned int), 1, run->fp) != 1) {
+	if (ferror(run->fp))
+	    OOPS(run->file_name);
+	return 0;
+    }
+
+    if (len >= run->max_len) {
+	run->max_len = 2 * len + 1;
+	if ((run->label = realloc(run->label, run->max_len)) == NULL)
+	    OOPS("Error: realloc()\n");
+    }
+
+    if (fread(run->label, 1, len, run->fp) != len
+	|| fread(&run->n_refs, sizeof(unsigned int), 1, run->fp) != 1)
+	OOPS(run->file_name);
+    run->label[len] = '\0';
+    run->len = len;
+
+    return 1;
+}
+
+/* restore the heap property of runs (least label first) from the i-th run */
+void SiftDownExtRun(EXT_RUN ** heap, unsigned int n_runs, unsigned int i)
+{
+    unsigned int child;
+    EXT_RUN *run;
+
+    run = heap[i];
+
+    while ((child = 2 * i + 1) < n_runs) {
+	if (child + 1 < n_runs
+	    && strcmp(heap[child + 1]->label, heap[child]->label) < 0)
+	    child++;
+
+	if (strcmp(heap[child]->label, run->label) >= 0)
+	    break;
+
+	heap[i] = heap[child];
+	i = child;
+    }
+
+    heap[i] = run;
+}
+
+/* open the next runs to merge (at most EXT_FANIN), returns the heap size */
+unsigned int InitExtHeap(EXT_DICT * ext, EXT_RUN * runs, EXT_RUN ** heap,
+			 unsigned int n_runs)
+{
+    unsigned int i, n_heap;
+    size_t buf_size;
+
+    /* the budget is shared by the stream buffers */
+    buf_size = ext->memory / 2 / (n_runs ? n_runs : 1);
+    if (buf_size > EXT_FILE_BUF)
+	buf_size = EXT_FILE_BUF;
+
+    for (i = 0, n_heap = 0; i < n_runs; i++) {
+	OpenExtRun(ext, &runs[i], ext->first_run + i, buf_size);
+	if (ReadExtGroup(&runs[i]))
+	    heap[n_heap++] = &runs[i];
+    }
+    ext->first_run += n_runs;
+
+    for (i = n_heap / 2; i-- > 0;)
+	SiftDownExtRun(heap, n_heap, i);
+
+    return n_heap;
+}
+
+/* move the least run to its next group, returns the heap size */
+unsigned int NextExtGroup(EXT_RUN ** heap, unsigned int n_heap)
+{
+    if (!ReadExtGroup(heap[0]))
+	heap[0] = heap[--n_heap];
+
+    if (n_heap)
+	SiftDownExtRun(heap, n_heap, 0);
+
+    return n_heap;
+}
+
+/* close & remove merged runs */
+void CloseExtRuns(EXT_RUN * runs, unsigned int n_runs)
+{
+    unsigned int i;
+
+    for (i = 0; i < n_runs; i++) {
+	FCLOSE(runs[i].fp, runs[i].file_name);
+	remove(runs[i].file_name);
+	free(runs[i].label);
+    }
+}
+
+/* merge the runs into runs of their groups until EXT_FANIN runs are left */
+void MergeExtRuns(EXT_DICT * ext)
+{
+    unsigned int n_heap, n;
+    unsigned long long pos[EXT_REFS];
+    char file_name[EXT_NAME];
+    EXT_RUN runs[EXT_FANIN], *heap[EXT_FANIN], *top;
+    FILE *fp;
+
+    while (ext->n_runs - ext->first_run > EXT_FANIN) {
+	n_heap = InitExtHeap(ext, runs, heap, EXT_FANIN);
+
+	sprintf(file_name, "%s.run%u.tmp", ext->prefix, ext->n_runs++);
+	FOPEN(fp, file_name, "wb");
+	setvbuf(fp, NULL, _IOFBF, EXT_FILE_BUF);
+
+	/* the groups of a label are copied one after the other */
+	while (n_heap) {
+	    top = heap[0];
+	    if (fwrite(&top->len, sizeof(unsigned int), 1, fp) != 1
+		|| fwrite(top->label, 1, top->len, fp) != top->len
+		|| fwrite(&top->n_refs, sizeof(unsigned int), 1, fp) != 1)
+		OOPS(file_name);
+
+	    while (top->n_refs) {
+		n = top->n_refs < EXT_REFS ? top->n_refs : EXT_REFS;
+		if (fread(pos, sizeof(unsigned long long), n, top->fp) != n)
+		    OOPS(top->file_name);
+		if (fwrite(pos, sizeof(unsigned long long), n, fp) != n)
+		    OOPS(file_name);
+		top->n_refs -= n;
+	    }
+
+	    n_heap = NextExtGroup(heap, n_heap);
+	}
+
+	FCLOSE(fp, file_name);
+	CloseExtRuns(runs, EXT_FANIN);
+    }
+}
+
+/*
+ * Number the distinct labels & write them into the node index (after its
+ * header), followed by their offsets, then write the edges with node
+ * indices into the edge index. Returns the number of nodes.
+ */
+unsigned int BuildExtIndex(EXT_DICT * ext, FILE * fp_nidx, char *nidx_name,
+			   EIDX_WRITER * writer)
+{
+    unsigned long long n_pos, bucket_size, pos[EXT_REFS], offset, start;
+    unsigned int i, b, n, n_buckets, n_runs, n_heap, node, max_last;
+    unsigned int pair[2], *ids, *pairs;
+    size_t buf_size;
+    char *last, pad[8] = { 0 };
+    char offsets_name[EXT_NAME], (*bucket_names)[EXT_NAME];
+    float *weights;
+    EXT_RUN runs[EXT_FANIN], *heap[EXT_FANIN], *top;
+    IDX_EDGE *edges;
+    FILE *fp_offsets, **fp_buckets;
+
+    /* the rest of the references is the last run */
+    WriteExtRun(ext);
+    free(ext->arena);
+    free(ext->refs);
+    ext->arena = NULL;
+    ext->refs = NULL;
+    MergeExtRuns(ext);
+
+    /* buckets of edge positions (at most EXT_MAX_BUCKETS, see GetExtMinMemory) */
+    n_pos = 2 * ext->n_edges;
+    bucket_size = ext->bucket_size;
+    n_buckets = (n_pos + bucket_size - 1) / bucket_size;
+
+    MALLOC(fp_buckets, sizeof(FILE *) * (n_buckets + 1));
+    MALLOC(bucket_names, sizeof(*bucket_names) * (n_buckets + 1));
+    buf_size = ext->memory / 2 / (n_buckets ? n_buckets : 1);
+    if (buf_size > EXT_FILE_BUF)
+	buf_size = EXT_FILE_BUF;
+    for (b = 0; b < n_buckets; b++) {
+	sprintf(bucket_names[b], "%s.ids%u.tmp", ext->prefix, b);
+	FOPEN(fp_buckets[b], bucket_names[b], "w+b");
+	setvbuf(fp_buckets[b], NULL, _IOFBF, buf_size);
+    }
+
+    sprintf(offsets_name, "%s.offsets.tmp", ext->prefix);
+    FOPEN(fp_offsets, offsets_name, "w+b");
+    setvbuf(fp_offsets, NULL, _IOFBF, EXT_FILE_BUF);
+
+    /* number the labels in order & spread their references over the buckets */
+    n_runs = ext->n_runs - ext->first_run;
+    n_heap = InitExtHeap(ext, runs, heap, n_runs);
+    last = NULL;
+    max_last = 0;
+    node = 0;
+
+    while (n_heap) {
+	top = heap[0];
+
+	if (!ext->n_nodes || strcmp(top->label, last)) {
+	    if (ext->n_nodes == UINT_MAX)
+		ExitIndexError(nidx_name, "would have too many nodes.");
+	    node = ext->n_nodes++;
+
+	    offset = ext->blob_size;
+	    if (fwrite(&offset, sizeof(unsigned long long), 1, fp_offsets) !=
+		1)
+		OOPS(offsets_name);
+	    if (fwrite(top->label, 1, top->len + 1, fp_nidx) != top->len + 1)
+		OOPS(nidx_name);
+	    ext->blob_size += top->len + 1;
+
+	    if (top->len >= max_last) {
+		max_last = 2 * top->len + 1;
+		if ((last = realloc(last, max_last)) == NULL)
+		    OOPS("Error: realloc()\n");
+	    }
+	    memcpy(last, top->label, top->len + 1);
+	}
+
+	while (top->n_refs) {
+	    n = top->n_refs < EXT_REFS ? top->n_refs : EXT_REFS;
+	    if (fread(pos, sizeof(unsigned long long), n, top->fp) != n)
+		OOPS(top->file_name);
+	    top->n_refs -= n;
+
+	    for (i = 0; i < n; i++) {
+		if (pos[i] >= n_pos)
+		    ExitIndexError(top->file_name, "is corrupted.");
+
+		b = pos[i] / bucket_size;
+		pair[0] = pos[i] % bucket_size;
+		pair[1] = node;
+		if (fwrite(pair, sizeof(pair), 1, fp_buckets[b]) != 1)
+		    OOPS(bucket_names[b]);
+	    }
+	}
+
+	n_heap = NextExtGroup(heap, n_heap);
+    }
+    CloseExtRuns(runs, n_runs);
+    free(last);
+
+    /* the offsets follow the labels, aligned to 8 bytes */
+    if (ext->blob_size % 8
+	&& fwrite(pad, 1, 8 - ext->blob_size % 8, fp_nidx) !=
+	8 - ext->blob_size % 8)
+	OOPS(nidx_name);
+
+    MALLOC(pairs, sizeof(unsigned int) * 2 * EXT_EDGES);
+    rewind(fp_offsets);
+    while ((n = fread(pairs, 1, sizeof(unsigned int) * 2 * EXT_EDGES,
+		      fp_offsets)) != 0)
+	if (fwrite(pairs, 1, n, fp_nidx) != n)
+	    OOPS(nidx_name);
+    if (ferror(fp_offsets))
+	OOPS(offsets_name);
+    FCLOSE(fp_offsets, offsets_name);
+    remove(offsets_name);
+
+    /* join the node indices of each bucket with the weights in edge order */
+    MALLOC(ids, sizeof(unsigned int) *
+	   (n_pos < bucket_size ? n_pos + 1 : bucket_size));
+    MALLOC(weights, sizeof(float) * EXT_EDGES);
+    MALLOC(edges, sizeof(IDX_EDGE) * EXT_EDGES);
+    rewind(ext->fp_weights);
+
+    for (b = 0; b < n_buckets; b++) {
+	rewind(fp_buckets[b]);
+	while ((n = fread(pairs, sizeof(pair), EXT_EDGES,
+			  fp_buckets[b])) != 0)
+	    for (i = 0; i < n; i++)
+		ids[pairs[2 * i]] = pairs[2 * i + 1];
+	if (ferror(fp_buckets[b]))
+	    OOPS(bucket_names[b]);
+	FCLOSE(fp_buckets[b], bucket_names[b]);
+	remove(bucket_names[b]);
+
+	/* the edges of the positions of the bucket */
+	n_pos = 2 * ext->n_edges - (unsigned long long) b * bucket_size;
+	if (n_pos > bucket_size)
+	    n_pos = bucket_size;
+
+	for (start = 0; start < n_pos / 2; start += n) {
+	    n = n_pos / 2 - start < EXT_EDGES ? n_pos / 2 - start : EXT_EDGES;
+	    if (fread(weights, sizeof(float), n, ext->fp_weights) != n)
+		OOPS(ext->weights_name);
+
+	    for (i = 0; i < n; i++) {
+		edges[i].nodeA = ids[2 * (start + i)];
+		edges[i].nodeB = ids[2 * (start + i) + 1];
+		edges[i].weight = weights[i];
+	    }
+	    WriteEidxEdges(writer, edges, n);
+	}
+    }
+
+    free(ids);
+    free(weights);
+    free(edges);
+    free(pairs);
+    free(fp_buckets);
+    free(bucket_names);
+
+    return ext->n_nodes;
+}
+
+/* release a dictionary & remove its temporary files */
+void CloseExtDict(EXT_DICT * ext)
+{
+    unsigned int i;
+    char file_name[EXT_NAME];
+
+    /* runs are left behind by an interrupted indexing */
+    for (i = ext->first_run; i < ext->n_runs; i++) {
+	sprintf(file_name, "%s.run%u.tmp", ext->prefix, i);
+	remove(file_name);
+    }
+
+    FCLOSE(ext->fp_weights, ext->weights_name);
+    remove(ext->weights_name);
+    free(ext->arena);
+    free(ext->refs);
+    free(ext);
+}
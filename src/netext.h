@@ -0,0 +1,108 @@
+/*
+ * File:	netext.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETEXT_H
+#define	NETEXT_H
+
+#define EXT_NAME 288		/* length of temporary file names */
+#define EXT_MIN_MEMORY 16	/* smallest memory budget (MB) */
+#define EXT_FANIN 64		/* sorted runs merged at once */
+#define EXT_MAX_BUCKETS 1024	/* files of node IDs by edge position */
+#define EXT_FILE_BUF 1048576	/* largest stream buffer of a temporary file */
+#define EXT_EDGES 65536		/* edges joined with their node IDs at once */
+#define EXT_REFS 1024		/* references of a label read at once */
+
+/* typedefs */
+typedef struct _ext_ref_ EXT_REF;	/* reference of an edge to a label */
+typedef struct _ext_run_ EXT_RUN;	/* sorted run of label references */
+typedef struct _ext_dict_ EXT_DICT;	/* external-memory node dictionary */
+
+/* type declarations */
+struct _ext_ref_ {
+    unsigned long long key;	/* first 8 bytes of the label (big-endian) */
+    char *label;		/* node label */
+    unsigned long long pos;	/* 2 * edge + 0 (node A) or 1 (node B) */
+};
+
+/*
+ * A run holds the references of its labels in label order, as groups of
+ *
+ *   [length of the label (4 bytes)] [label] [number of references (4 bytes)]
+ *   [positions of the references (8 bytes each)]
+ */
+struct _ext_run_ {
+    char file_name[EXT_NAME];	/* run file */
+    FILE *fp;			/* run stream */
+    char *label;		/* label of the current group */
+    unsigned int len;		/* length of the label */
+    unsigned int max_len;	/* allocated length of the label */
+    unsigned int n_refs;	/* references of the current group */
+};
+
+/*
+ * The labels of the edges are sorted on disk in runs that fit the memory
+ * budget, then merged: the distinct labels get node indices in label order
+ * & their references are spread over buckets of edge positions, each of
+ * which fits the budget when the edges are rewritten to node indices.
+ */
+struct _ext_dict_ {
+    char *prefix;		/* prefix of the temporary files */
+    size_t memory;		/* memory budget in bytes */
+    char *arena;		/* labels of the current run */
+    size_t arena_used;		/* used size of the arena */
+    size_t max_arena;		/* size of the arena */
+    EXT_REF *refs;		/* references of the current run */
+    size_t n_refs;		/* number of references */
+    size_t max_refs;		/* allocated number of references */
+    unsigned int n_runs;	/* number of runs written */
+    unsigned int first_run;	/* first run not merged yet */
+    char weights_name[EXT_NAME];	/* file of the edge weights */
+    FILE *fp_weights;		/* weights in edge order */
+    unsigned long long n_edges;	/* number of edges */
+    unsigned long long bucket_size;	/* edge positions per bucket */
+    unsigned int n_nodes;	/* number of distinct labels */
+    unsigned long long blob_size;	/* size of the labels */
+};
+
+/* function prototypes */
+extern EXT_DICT *OpenExtDict(char *, unsigned long long);
+extern int CmpExtRefs(const void *, const void *);
+extern void AddExtLabel(EXT_DICT *, char *, unsigned long long);
+extern void AddExtEdge(EXT_DICT *, EDGE *);
+extern unsigned long long GetExtMinMemory(EXT_DICT *);
+extern void WriteExtRun(EXT_DICT *);
+extern void OpenExtRun(EXT_DICT *, EXT_RUN *, unsigned int, size_t);
+extern unsigned int ReadExtGroup(EXT_RUN *);
+extern void SiftDownExtRun(EXT_RUN **, unsigned int, unsigned int);
+extern unsigned int InitExtHeap(EXT_DICT *, EXT_RUN *, EXT_RUN **,
+				unsigned int);
+extern unsigned int NextExtGroup(EXT_RUN **, unsigned int);
+extern void CloseExtRuns(EXT_RUN *, unsigned int);
+extern void MergeExtRuns(EXT_DICT *);
+extern unsigned int BuildExtIndex(EXT_DICT *, FILE *, char *,
+				  EIDX_WRITER *);
+extern void CloseExtDict(EXT_DICT *);
+
+#endif				/* NETEXT_H */
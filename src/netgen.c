@@ -0,0 +1,280 @@
+/*
+ * File:	netgen.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Generator of synthetic graphs for benchmarking netindex & netclust.
+ *
+ * The nodes are split into planted clusters (node modulo the number of
+ * clusters). Edges within a cluster get the better half of the weights
+ * (similarity scores 500..1000, distances 0..0.5), the other edges the worse
+ * half, so that the planted clusters are the single-linkage clusters at the
+ * middle cutoff (S 500 or D 0.5) when each cluster is connected. Both nodes of
+ * an edge are drawn from power-law ranks, scattered over the node indices by
+ * a permutation. The output depends on the settings & the seed only.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "netgen.h"
+
+/* print program usage */
+void NgenUsage()
+{
+    printf
+	("**************************************************\n");
+    printf
+	(" netgen v1.0 - synthetic graph (network) generator\n");
+    printf
+	("**************************************************\n");
+    printf
+	(" Description:\n\tThe program writes a reproducible edge list for benchmarking\n\tthe 'netindex' & 'netclust' programs.\n");
+    printf
+	(" Usage:\n");
+    printf("       netgen [OPTIONS] [FILE]\n\n");
+    printf
+	("       FILE (mandatory)         - output file of graph edges ('-' for STDOUT)\n\n");
+    printf(" Options:\n");
+    printf
+	("       -c CLUSTERS - number of planted clusters (default NODES / 100)\n");
+    printf
+	("       -d - write distances 0..1 (default similarity scores 0..1000)\n");
+    printf
+	("       -e EDGES - number of edges (default 10 * NODES, e.g. 1e9)\n");
+    printf
+	("       -i FRACTION - fraction of edges within clusters (default 0.8)\n");
+    printf
+	("       -k SKEW - exponent of power-law node ranks, 1 is uniform (default 2)\n");
+    printf
+	("       -l LENGTH - length of node labels (default 10)\n");
+    printf
+	("       -n NODES - number of nodes (default 1000000)\n");
+    printf
+	("       -r SEED - seed of the random numbers (default 1)\n\n");
+
+    exit(EXIT_FAILURE);
+}
+
+/* set generator settings */
+NGEN_SET NgenStoreSet(int argc, char **argv)
+{
+    int opt;
+    double n_nodes, n_edges, n_clusters;
+    NGEN_SET set;
+
+    /* init variables */
+    n_nodes = 1000000;
+    n_edges = 0;
+    n_clusters = 0;
+    set.label_len = 10;
+    set.weight_type = 0;
+    set.intra = 0.8;
+    set.skew = 2;
+    set.seed = 1;
+
+    /* parse options (counts may be given as 1e9) */
+    while ((opt = getopt(argc, argv, "c:de:i:k:l:n:r:")) != -1) {
+	switch (opt) {
+	case 'c':
+	    n_clusters = atof(optarg);
+	    break;
+	case 'd':
+	    set.weight_type = 1;
+	    break;
+	case 'e':
+	    n_edges = atof(optarg);
+	    break;
+	case 'i':
+	    set.intra = atof(optarg);
+	    break;
+	case 'k':
+	    set.skew = atof(optarg);
+	    break;
+	case 'l':
+	    set.label_len = atoi(optarg);
+	    break;
+	case 'n':
+	    n_nodes = atof(optarg);
+	    break;
+	case 'r':
+	    set.seed = strtoull(optarg, NULL, 10);
+	    break;
+	default:
+	    NgenUsage();
+	}
+    }
+
+    /* validate the settings */
+    if (optind != argc - 1 || strlen(argv[optind]) >= BUF
+	|| n_nodes < 2 || n_nodes > 4294967295.0
+	|| n_edges < 0 || n_edges > 1.8e19 || n_clusters < 0
+	|| n_clusters > n_nodes || set.intra < 0 || set.intra > 1
+	|| set.skew < 1 || set.label_len < 2
+	|| set.label_len > NGEN_MAX_LABEL)
+	NgenUsage();
+
+    set.n_nodes = (unsigned int) n_nodes;
+    set.n_edges = n_edges ? (unsigned long long) n_edges :
+	10ULL * set.n_nodes;
+    set.n_clusters = n_clusters ? (unsigned int) n_clusters :
+	(set.n_nodes >= 100 ? set.n_nodes / 100 : 1);
+    set.state = set.seed;
+    strcpy(set.outfile, argv[optind]);
+
+    return set;
+}
+
+/* get the next random number (splitmix64) */
+unsigned long long NextRandom(NGEN_SET * set)
+{
+    unsigned long long z;
+
+    z = (set->state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+
+    return z ^ (z >> 31);
+}
+
+/* get a random number in [0, 1) */
+double NextUniform(NGEN_SET * set)
+{
+    return (NextRandom(set) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* get a rank in [0, n), low ranks are drawn more often for a skew above 1 */
+unsigned int PowerLawRank(NGEN_SET * set, unsigned int n)
+{
+    unsigned int rank;
+    double u;
+
+    u = NextUniform(set);
+    if (set->skew != 1)
+	u = set->skew == 2 ? u * u : pow(u, set->skew);
+
+    rank = (unsigned int) (u * n);
+    return rank < n ? rank : n - 1;
+}
+
+/* scatter the ranks over the indices [0, n) (a bijection) */
+unsigned int PermuteNode(unsigned int rank, unsigned int n)
+{
+    /* a prime multiplier is coprime with any smaller n */
+    if (n < 2654435761U)
+	return ((unsigned long long) rank * 2654435761U + n / 2) % n;
+
+    return rank;
+}
+
+/* get a weight in units, the better half for edges within clusters */
+unsigned int GenerateWeight(NGEN_SET * set, unsigned int intra)
+{
+    unsigned int units;
+
+    units = (unsigned int) (NextUniform(set) * (NGEN_UNITS / 2));
+
+    /* high scores (S 500..999.9) or low distances (D 0..0.4999) within
+     * clusters; the other distances fail the middle cutoff (D 0.5001..1) */
+    if (intra != set->weight_type)
+	units += NGEN_UNITS / 2 + set->weight_type;
+
+    return units;
+}
+
+/* write the label of a node ("n" & digits padded to a length) */
+unsigned int FormatLabel(char *str, unsigned int node, unsigned int len)
+{
+    char digits[16];
+    unsigned int i, n;
+
+    for (n = 0; n == 0 || node; node /= 10)
+	digits[n++] = '0' + node % 10;
+
+    str[0] = 'n';
+    for (i = 1; i + n < len; i++)
+	str[i] = '0';
+    while (n)
+	str[i++] = digits[--n];
+
+    return i;
+}
+
+/* write a weight of units (tenths of scores or 1/10000 of distances) */
+unsigned int FormatWeight(char *str, unsigned int units,
+			  unsigned int weight_type)
+{
+    if (weight_type)
+	return sprintf(str, "%u.%04u", units / NGEN_UNITS,
+		       units % NGEN_UNITS);
+
+    return sprintf(str, "%u.%u", units / 10, units % 10);
+}
+
+/* write the edges of a graph */
+void GenerateGraph(NGEN_SET * set)
+{
+    unsigned long long i;
+    unsigned int node_a, node_b, cluster, size, intra, n;
+    char line[2 * NGEN_MAX_LABEL + 32];
+    FILE *fp;
+
+    if (!strcmp(set->outfile, "-"))
+	fp = stdout;
+    else
+	FOPEN(fp, set->outfile, "w");
+    setvbuf(fp, NULL, _IOFBF, NGEN_OUT_BUF);
+
+    for (i = 0; i < set->n_edges; i++) {
+	node_a = PermuteNode(PowerLawRank(set, set->n_nodes), set->n_nodes);
+	intra = NextUniform(set) < set->intra;
+
+	if (intra) {
+	    /* the nodes of a cluster are cluster, cluster + k, ... */
+	    cluster = node_a % set->n_clusters;
+	    size = (set->n_nodes - cluster + set->n_clusters - 1) /
+		set->n_clusters;
+	    node_b = cluster + set->n_clusters *
+		PermuteNode(PowerLawRank(set, size), size);
+	} else
+	    node_b = PermuteNode(PowerLawRank(set, set->n_nodes),
+				 set->n_nodes);
+
+	n = FormatLabel(line, node_a, set->label_len);
+	line[n++] = '\t';
+	n += FormatLabel(line + n, node_b, set->label_len);
+	line[n++] = '\t';
+	n += FormatWeight(line + n, GenerateWeight(set, intra),
+			  set->weight_type);
+	line[n++] = '\n';
+
+	if (fwrite(line, n, 1, fp) != 1)
+	    OOPS(set->outfile);
+    }
+
+    if ((fp == stdout ? fflush(fp) : fclose(fp)) != 0)
+	OOPS(set->outfile);
+}
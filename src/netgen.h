@@ -0,0 +1,63 @@
+/*
+ * File:	netgen.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETGEN_H
+#define	NETGEN_H
+
+#define BUF 255			/* string buffer */
+#define NGEN_OUT_BUF 4194304	/* output buffer of the edge list */
+#define NGEN_MAX_LABEL 64	/* maximum length of node labels */
+#define NGEN_UNITS 10000	/* weight units: tenths of scores 0..1000 (S), 1/10000 of distances (D) */
+
+/* typedefs */
+typedef struct _ngen_set_ NGEN_SET;	/* generator settings */
+
+/* type declarations */
+struct _ngen_set_ {
+    unsigned int n_nodes;	/* number of nodes */
+    unsigned long long n_edges;	/* number of edges */
+    unsigned int n_clusters;	/* number of planted clusters */
+    unsigned int label_len;	/* length of node labels */
+    unsigned int weight_type;	/* 0 - similarity scores, 1 - distances */
+    double intra;		/* fraction of edges within planted clusters */
+    double skew;		/* exponent of the power-law node ranks (>= 1) */
+    unsigned long long seed;	/* seed of the random numbers */
+    unsigned long long state;	/* state of the random numbers */
+    char outfile[BUF];		/* output file of edges ("-" - STDOUT) */
+};
+
+/* function prototypes */
+extern void NgenUsage();
+extern NGEN_SET NgenStoreSet(int, char **);
+extern unsigned long long NextRandom(NGEN_SET *);
+extern double NextUniform(NGEN_SET *);
+extern unsigned int PowerLawRank(NGEN_SET *, unsigned int);
+extern unsigned int PermuteNode(unsigned int, unsigned int);
+extern unsigned int GenerateWeight(NGEN_SET *, unsigned int);
+extern unsigned int FormatLabel(char *, unsigned int, unsigned int);
+extern unsigned int FormatWeight(char *, unsigned int, unsigned int);
+extern void GenerateGraph(NGEN_SET *);
+
+#endif				/* NETGEN_H */
@@ -0,0 +1,66 @@
+/*
+ * File:	netgen_main.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Program description:
+ *  netgen writes a synthetic graph (edge list) in the input format of netindex
+ *  for benchmarking; the same settings & seed give the same file.
+ *
+ * Inputs:
+ *  FILE (mandatory) - output file of edges, "-" for STDOUT
+ *
+ *  -c CLUSTERS - number of planted clusters (default NODES / 100)
+ *  -d - write distances 0..1 instead of similarity scores 0..1000
+ *  -e EDGES - number of edges, up to billions streamed to FILE (default 10 * NODES)
+ *  -i FRACTION - fraction of edges within the planted clusters (default 0.8)
+ *  -k SKEW - exponent of power-law node ranks; 1 draws the nodes uniformly (default 2)
+ *  -l LENGTH - length of node labels (default 10)
+ *  -n NODES - number of nodes (default 1000000)
+ *  -r SEED - seed of the random numbers (default 1)
+ *
+ *  The edges within the planted clusters pass the middle cutoff (S 500 or
+ *  D 0.5), the other edges fail it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "net.h"
+#include "netgen.h"
+
+int main(int argc, char **argv)
+{
+    NGEN_SET set;
+
+    /* validate the number of input parameters */
+    if (argc < 2)
+	NgenUsage();
+
+    /* store generator settings */
+    set = NgenStoreSet(argc, argv);
+
+    /* write the edges */
+    GenerateGraph(&set);
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,449 @@
+/*
+ * File:	nethash.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Dictionary of node labels.
+ *
+ * Node labels are mapped to consecutive node indices (in the order of their
+ * insertion) by a growable open-addressing hash table. The keys are stored
+ * back to back in a single arena instead of one allocation per key.
+ *
+ * Parser threads share a dictionary split into shards, each with its own lock;
+ * the provisional IDs of the shards are renumbered to consecutive node indices
+ * (in the order of the edges) by a single thread afterwards.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "nethash.h"
+
+/* allocate a hash table of a size rounded up to a power of two (or NULL) */
+HASH_TABLE *AllocHashTable(unsigned int size)
+{
+    unsigned int i;
+    HASH_TABLE *table;
+
+    if (size < 1 || size > 0x80000000U
+	|| (table = malloc(sizeof(HASH_TABLE))) == NULL)
+	return NULL;
+
+    for (table->size = 1; table->size < size; table->size <<= 1);
+
+    table->slots = malloc(table->size * sizeof(HASH_SLOT));
+    table->offsets = malloc(HASH_MAX_KEYS(table->size) *
+			    sizeof(unsigned long long));
+    table->arena_size = HASH_ARENA(table->size);
+    table->arena = malloc(table->arena_size);
+
+    if (table->slots == NULL || table->offsets == NULL
+	|| table->arena == NULL) {
+	FreeHashTable(table);
+	return NULL;
+    }
+
+    /* init table */
+    for (i = 0; i < table->size; i++)
+	table->slots[i].value = 0;
+
+    table->n_keys = 0;
+    table->arena_used = 0;
+
+    return table;
+}
+
+/* create a new hash table, the size is rounded up to a power of two */
+HASH_TABLE *NewHashTable(unsigned int size)
+{
+    HASH_TABLE *table;
+
+    if (size < 1) {
+	fputs("Error: Hash table cannot be of zero size.\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+
+    if ((table = AllocHashTable(size)) == NULL)
+	OOPS("Error: malloc()\n");
+
+    return table;
+}
+
+/* release memory of a hash table */
+void FreeHashTable(HASH_TABLE * pt_table)
+{
+    /* a partly allocated table is released too */
+    free(pt_table->slots);
+    free(pt_table->offsets);
+    free(pt_table->arena);
+    free(pt_table);
+}
+
+/* hashing function (64-bit multiply-xorshift over 8-byte words) */
+unsigned long long HashKey(const char *key, size_t len)
+{
+    unsigned long long h, w;
+
+    h = len * 0x9e3779b97f4a7c15ULL;
+
+    for (; len >= 8; key += 8, len -= 8) {
+	memcpy(&w, key, 8);
+	h = (h ^ w) * 0xff51afd7ed558ccdULL;
+	h ^= h >> 29;
+    }
+
+    if (len) {
+	w = 0;
+	memcpy(&w, key, len);
+	h = (h ^ w) * 0xff51afd7ed558ccdULL;
+    }
+
+    /* finalize (MurmurHash3 fmix64) */
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+/* double the number of slots & re-insert all keys, returns 1 if out of memory */
+unsigned int ResizeHashTable(HASH_TABLE * pt_table)
+{
+    unsigned int i, j, mask, size;
+    unsigned long long *offsets;
+    HASH_SLOT *slots;
+
+    if (pt_table->size == 0x80000000U)
+	return 1;
+
+    /* the table is left as it is if either allocation fails */
+    size = pt_table->size << 1;
+    mask = size - 1;
+
+    if ((slots = malloc(size * sizeof(HASH_SLOT))) == NULL)
+	return 1;
+
+    if ((offsets = realloc(pt_table->offsets, HASH_MAX_KEYS(size) *
+			   sizeof(unsigned long long))) == NULL) {
+	free(slots);
+	return 1;
+    }
+    pt_table->offsets = offsets;
+
+    for (i = 0; i < size; i++)
+	slots[i].value = 0;
+
+    /* the stored hash bits are enough to find the new slot */
+    for (i = 0; i < pt_table->size; i++) {
+	if (!pt_table->slots[i].value)
+	    continue;
+	for (j = pt_table->slots[i].hash & mask; slots[j].value;
+	     j = (j + 1) & mask);
+	slots[j] = pt_table->slots[i];
+    }
+
+    free(pt_table->slots);
+    pt_table->slots = slots;
+    pt_table->size = size;
+
+    return 0;
+}
+
+/* double the number of slots & re-insert all keys */
+void GrowHashTable(HASH_TABLE * pt_table)
+{
+    if (pt_table->size == 0x80000000U) {
+	fputs("Error: Hash table cannot grow any further.\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+
+    if (ResizeHashTable(pt_table))
+	OOPS("Error: realloc()\n");
+}
+
+/*
+ * get the value of a key of a given length & hash (lower 32 bits), add the key
+ * with the next value if not found; returns 1 (with the table unchanged) if out
+ * of memory
+ */
+unsigned int InsertHashedKey(HASH_TABLE * pt_table, char *key, size_t len,
+			     unsigned int hash, unsigned int *pt_value,
+			     unsigned int *pt_new)
+{
+    unsigned int i, mask;
+    unsigned long long arena_size;
+    char *arena;
+    HASH_SLOT *slot;
+
+    mask = pt_table->size - 1;
+
+    for (i = hash & mask; pt_table->slots[i].value; i = (i + 1) & mask) {
+	slot = &pt_table->slots[i];
+	if (slot->hash == hash
+	    && strcmp(key,
+		      pt_table->arena + pt_table->offsets[slot->value - 1]) ==
+	    0) {
+	    *pt_new = 0;
+	    *pt_value = slot->value - 1;
+	    return 0;
+	}
+    }
+
+    /* copy the key into the arena */
+    if (pt_table->arena_used + len + 1 > pt_table->arena_size) {
+	for (arena_size = pt_table->arena_size;
+	     pt_table->arena_used + len + 1 > arena_size; arena_size *= 2);
+	if ((arena = realloc(pt_table->arena, arena_size)) == NULL)
+	    return 1;
+	pt_table->arena = arena;
+	pt_table->arena_size = arena_size;
+    }
+
+    /* keep the load factor below 3/4 (the table grows before it is full) */
+    if (pt_table->n_keys + 1 == HASH_MAX_KEYS(pt_table->size)) {
+	if (ResizeHashTable(pt_table))
+	    return 1;
+	mask = pt_table->size - 1;
+	for (i = hash & mask; pt_table->slots[i].value; i = (i + 1) & mask);
+    }
+    memcpy(pt_table->arena + pt_table->arena_used, key, len + 1);
+
+    /* add the key-value pair */
+    pt_table->offsets[pt_table->n_keys] = pt_table->arena_used;
+    pt_table->arena_used += len + 1;
+    pt_table->slots[i].hash = hash;
+    pt_table->slots[i].value = ++pt_table->n_keys;
+
+    *pt_new = 1;
+    *pt_value = pt_table->n_keys - 1;
+    return 0;
+}
+
+/*
+ * get the value of a key, add the key with the next value if not found;
+ * returns 1 (with the table unchanged) if out of memory
+ */
+unsigned int InsertHashKey(HASH_TABLE * pt_table, char *key,
+			   unsigned int *pt_value, unsigned int *pt_new)
+{
+    size_t len;
+
+    len = strlen(key);
+    return InsertHashedKey(pt_table, key, len,
+			   (unsigned int) HashKey(key, len), pt_value, pt_new);
+}
+
+/* get the value of a key, add the key with the next value if not found */
+unsigned int AddHashKey(HASH_TABLE * pt_table, char *key,
+			unsigned int *pt_new)
+{
+    unsigned int value;
+
+    if (InsertHashKey(pt_table, key, &value, pt_new)) {
+	if (pt_table->size == 0x80000000U) {
+	    fputs("Error: Hash table cannot grow any further.\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+	OOPS("Error: realloc()\n");
+    }
+
+    return value;
+}
+
+/* lookup function for hash value, returns zero if the key is not found */
+unsigned int GetHashValue(HASH_TABLE * pt_table, char *key,
+			  unsigned int *pt_value)
+{
+    unsigned int i, mask, hash;
+    HASH_SLOT *slot;
+
+    hash = (unsigned int) HashKey(key, strlen(key));
+    mask = pt_table->size - 1;
+
+    for (i = hash & mask; pt_table->slots[i].value; i = (i + 1) & mask) {
+	slot = &pt_table->slots[i];
+	if (slot->hash == hash
+	    && strcmp(key,
+		      pt_table->arena + pt_table->offsets[slot->value - 1]) ==
+	    0) {
+	    *pt_value = slot->value - 1;
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/* get the key of a value */
+char *GetHashKey(HASH_TABLE * pt_table, unsigned int value)
+{
+    return pt_table->arena + pt_table->offsets[value];
+}
+
+/* create a concurrent dictionary of n_shards shards (rounded up to a power of two) */
+SHARD_TABLE *NewShardTable(unsigned int n_shards, unsigned int size)
+{
+    unsigned int i;
+    SHARD_TABLE *table;
+
+    if (n_shards < 1 || n_shards > 65536 || size < 1) {
+	fputs("Error: Hash table cannot be of zero size.\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+
+    MALLOC(table, sizeof(SHARD_TABLE));
+    for (table->n_shards = 1, table->shard_bits = 0;
+	 table->n_shards < n_shards;
+	 table->n_shards <<= 1, table->shard_bits++);
+
+    MALLOC(table->tables, table->n_shards * sizeof(HASH_TABLE *));
+    MALLOC(table->locks, table->n_shards * sizeof(pthread_mutex_t));
+    MALLOC(table->dense, table->n_shards * sizeof(unsigned int *));
+    MALLOC(table->max_dense, table->n_shards * sizeof(unsigned int));
+
+    /* the slots are spread over the shards */
+    size = size > table->n_shards ? size / table->n_shards : 1;
+    for (i = 0; i < table->n_shards; i++) {
+	if ((table->tables[i] = AllocHashTable(size)) == NULL)
+	    OOPS("Error: malloc()\n");
+	pthread_mutex_init(&table->locks[i], NULL);
+	table->dense[i] = NULL;
+	table->max_dense[i] = 0;
+    }
+
+    table->n_keys = 0;
+    table->max_keys = size;
+    table->arena_used = 0;
+    MALLOC(table->offsets, table->max_keys * sizeof(unsigned long long));
+
+    return table;
+}
+
+/* release memory of a concurrent dictionary */
+void FreeShardTable(SHARD_TABLE * pt_table)
+{
+    unsigned int i;
+
+    for (i = 0; i < pt_table->n_shards; i++) {
+	FreeHashTable(pt_table->tables[i]);
+	pthread_mutex_destroy(&pt_table->locks[i]);
+	free(pt_table->dense[i]);
+    }
+    free(pt_table->tables);
+    free(pt_table->locks);
+    free(pt_table->dense);
+    free(pt_table->max_dense);
+    free(pt_table->offsets);
+    free(pt_table);
+}
+
+/*
+ * get the provisional ID of a key, add the key to its shard if not found;
+ * threads may add keys at the same time
+ */
+unsigned int AddShardKey(SHARD_TABLE * pt_table, char *key,
+			 unsigned int *pt_new)
+{
+    unsigned int shard, value, status;
+    unsigned long long hash;
+    size_t len;
+
+    len = strlen(key);
+    hash = HashKey(key, len);
+    shard = (unsigned int) (hash >> 32) & (pt_table->n_shards - 1);
+
+    pthread_mutex_lock(&pt_table->locks[shard]);
+    status = InsertHashedKey(pt_table->tables[shard], key, len,
+			     (unsigned int) hash, &value, pt_new);
+    pthread_mutex_unlock(&pt_table->locks[shard]);
+
+    /* the value must leave the lower bits to the shard */
+    if (status && pt_table->tables[shard]->size != 0x80000000U)
+	OOPS("Error: realloc()\n");
+    if (status || (pt_table->shard_bits
+		   && value >> (32 - pt_table->shard_bits))) {
+	fputs("Error: Hash table cannot grow any further.\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+
+    return value << pt_table->shard_bits | shard;
+}
+
+/* get the key of a provisional ID (no keys may be added meanwhile) */
+char *GetShardKey(SHARD_TABLE * pt_table, unsigned int id)
+{
+    return GetHashKey(pt_table->tables[id & (pt_table->n_shards - 1)],
+		      id >> pt_table->shard_bits);
+}
+
+/*
+ * get the dense ID of a provisional ID, numbering it next if it has none yet;
+ * a single thread renumbers the IDs once the keys are added
+ */
+unsigned int GetDenseId(SHARD_TABLE * pt_table, unsigned int id,
+			unsigned int *pt_new)
+{
+    unsigned int shard, value, n;
+    unsigned int *dense;
+    unsigned long long *offsets;
+
+    shard = id & (pt_table->n_shards - 1);
+    value = id >> pt_table->shard_bits;
+
+    /* the dense IDs of a shard cover all its keys */
+    if (value >= pt_table->max_dense[shard]) {
+	n = pt_table->tables[shard]->n_keys;
+	if ((dense = realloc(pt_table->dense[shard],
+			     n * sizeof(unsigned int))) == NULL)
+	    OOPS("Error: realloc()\n");
+	memset(dense + pt_table->max_dense[shard], 0,
+	       (n - pt_table->max_dense[shard]) * sizeof(unsigned int));
+	pt_table->dense[shard] = dense;
+	pt_table->max_dense[shard] = n;
+    }
+
+    if (pt_table->dense[shard][value]) {
+	*pt_new = 0;
+	return pt_table->dense[shard][value] - 1;
+    }
+
+    if (pt_table->n_keys == pt_table->max_keys) {
+	n = pt_table->max_keys > 0x7fffffffU ?
+	    0xffffffffU : 2 * pt_table->max_keys;
+	if ((offsets = realloc(pt_table->offsets,
+			       n * sizeof(unsigned long long))) == NULL)
+	    OOPS("Error: realloc()\n");
+	pt_table->offsets = offsets;
+	pt_table->max_keys = n;
+    }
+
+    /* the key follows the keys of the lower dense IDs */
+    pt_table->offsets[pt_table->n_keys] = pt_table->arena_used;
+    pt_table->arena_used += strlen(GetShardKey(pt_table, id)) + 1;
+    pt_table->dense[shard][value] = ++pt_table->n_keys;
+
+    *pt_new = 1;
+    return pt_table->n_keys - 1;
+}
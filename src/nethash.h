@@ -0,0 +1,101 @@
+/*
+ * File:	nethash.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETHASH_H
+#define	NETHASH_H
+
+#define HASH_TABLE_SZ 1048576	/* initial number of hash table slots */
+#define HASH_ARENA_SZ 16777216	/* initial size of the key arena */
+#define HASH_SHARDS 64		/* shards of a concurrent dictionary */
+#define HASH_MAX_KEYS(s) ((s) - (s) / 4)	/* keys before the table grows */
+
+/* get the initial size of the key arena of a table of s slots */
+#define HASH_ARENA(s) ((s) < HASH_ARENA_SZ / 16 ? 16ULL * (s) : HASH_ARENA_SZ)
+
+/* typedefs */
+typedef struct _hash_slot_ HASH_SLOT;
+typedef struct _hash_table_ HASH_TABLE;
+typedef struct _shard_table_ SHARD_TABLE;	/* concurrent dictionary */
+
+/* type declarations */
+struct _hash_slot_ {
+    unsigned int hash;		/* lower 32 bits of the key hash */
+    unsigned int value;		/* value + 1 of the key (0 - empty slot) */
+};
+
+struct _hash_table_ {
+    unsigned int size;		/* number of slots (power of two) */
+    unsigned int n_keys;	/* number of keys */
+    HASH_SLOT *slots;		/* open-addressing slots (linear probing) */
+    unsigned long long *offsets;	/* arena offset of the key of each value */
+    char *arena;		/* NUL-terminated keys stored back to back */
+    unsigned long long arena_size;	/* allocated size of the arena */
+    unsigned long long arena_used;	/* used size of the arena */
+};
+
+/*
+ * A concurrent dictionary splits the keys into shards by the upper 32 bits of
+ * their hash, each a hash table under its own lock, so that threads inserting
+ * keys of different shards do not wait for each other. A key gets a
+ * provisional ID (its value in the shard & the shard in the lower bits);
+ * provisional IDs are renumbered to dense IDs (0, 1, 2, ...) in the order they
+ * are asked for once the keys are inserted, and the offsets of the keys in
+ * that order are kept, as those of a single hash table are.
+ */
+struct _shard_table_ {
+    unsigned int n_shards;	/* number of shards (power of two) */
+    unsigned int shard_bits;	/* bits of the shard in a provisional ID */
+    HASH_TABLE **tables;	/* keys of each shard */
+    pthread_mutex_t *locks;	/* lock of each shard */
+    unsigned int **dense;	/* dense ID + 1 of each key of a shard (0 - none) */
+    unsigned int *max_dense;	/* allocated dense IDs of each shard */
+    unsigned int n_keys;	/* number of dense IDs */
+    unsigned int max_keys;	/* allocated offsets */
+    unsigned long long *offsets;	/* offset of the key of each dense ID */
+    unsigned long long arena_used;	/* size of the keys in dense order */
+};
+
+/* function prototypes */
+extern HASH_TABLE *AllocHashTable(unsigned int);
+extern HASH_TABLE *NewHashTable(unsigned int);
+extern void FreeHashTable(HASH_TABLE *);
+extern unsigned long long HashKey(const char *, size_t);
+extern unsigned int ResizeHashTable(HASH_TABLE *);
+extern void GrowHashTable(HASH_TABLE *);
+extern unsigned int InsertHashedKey(HASH_TABLE *, char *, size_t,
+				    unsigned int, unsigned int *,
+				    unsigned int *);
+extern unsigned int InsertHashKey(HASH_TABLE *, char *, unsigned int *,
+				  unsigned int *);
+extern unsigned int AddHashKey(HASH_TABLE *, char *, unsigned int *);
+extern unsigned int GetHashValue(HASH_TABLE *, char *, unsigned int *);
+extern char *GetHashKey(HASH_TABLE *, unsigned int);
+extern SHARD_TABLE *NewShardTable(unsigned int, unsigned int);
+extern void FreeShardTable(SHARD_TABLE *);
+extern unsigned int AddShardKey(SHARD_TABLE *, char *, unsigned int *);
+extern char *GetShardKey(SHARD_TABLE *, unsigned int);
+extern unsigned int GetDenseId(SHARD_TABLE *, unsigned int, unsigned int *);
+
+#endif				/* NETHASH_H */
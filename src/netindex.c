@@ -31,7 +31,7 @@
  * 
  *   - columns separated by space " " or tab "\t"
  *		- space(s) are not allowed within the columns
- *		- both 'nodeA' and 'nodeB' are read as strings (max. size specified by NODE_BUF variable)
+ *		- both 'nodeA' and 'nodeB' are read as strings of any length
  *		- 'weight' can be integer or float
  * 
  * The program generates 2 or 3 output files from an input FILE with the following suffixes:
@@ -54,6 +54,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <float.h>
+#include <unistd.h>
+#include "netio.h"
+#include "netparse.h"
+#include "nethash.h"
+#include "netext.h"
 #include "netindex.h"
 
 /* print program usage */
@@ -66,14 +72,14 @@ void NidxUsage()
     printf
 	("**************************************************\n");
     printf
-        (" Author:\n\tArnold Kuzniar\n");
+	(" Author:\n\tArnold Kuzniar\n");
     printf
-        (" Last update:\n\tApr 2008\n");
+	(" Last update:\n\tApr 2008\n");
     printf
 	(" Description:\n\tThe program indexes an input graph for the 'netclust' program.\n");
     printf
 	(" Usage:\n");
-    printf("       netindex [FILE] [WEIGHT TYPE] [WEIGHT CUTOFF]\n\n");
+    printf("       netindex [OPTIONS] [FILE] [WEIGHT TYPE] [WEIGHT CUTOFF]\n\n");
     printf
 	("       FILE (mandatory)         - input file of graph edges\n");
     printf
@@ -83,6 +89,46 @@ void NidxUsage()
 	("                                  range of values for S - 0..N (default 0)\n");
     printf
 	("                                  range of values for D - 0..1 (default 1)\n\n");
+    printf(" Options:\n");
+    printf
+	("       -a INDEX - append the edges of FILE to the index of an INDEX file, with\n");
+    printf
+	("            its weight type & cutoff (WEIGHT TYPE & CUTOFF are not given)\n");
+    printf
+	("       -e - write the edges passing the cutoff as text too (FILE.sube),\n");
+    printf
+	("            'netexport' rebuilds the file from the index otherwise\n");
+    printf
+	("       -f - keep only the edges of the maximum (S) or minimum (D) spanning\n");
+    printf
+	("            forest in the edge index, sorted by weight (best first)\n");
+    printf
+	("            or, with -z, in frames sorted by weight\n");
+    printf
+	("       -j - write the log as JSON too (FILE.netindex.json)\n");
+    printf
+	("       -m MEMORY - index with a dictionary of node labels on disk, using\n");
+    printf
+	("            about MEMORY megabytes (at least %d) besides the input blocks\n",
+	 EXT_MIN_MEMORY);
+    printf
+	("       -p SECONDS - report the progress to STDERR every SECONDS (it is\n");
+    printf
+	("            reported on the signal SIGUSR1 anyway)\n");
+    printf
+	("       -q BITS - quantize the weights in the edge index to codes [8/16]\n");
+    printf
+	("       -s - sort the edge index by weight (best first), so that only the\n");
+    printf
+	("            edges passing a cutoff are read by 'netclust' (with -z, the\n");
+    printf
+	("            frames are sorted, the edges of a frame by node indices)\n");
+    printf
+	("       -t THREADS - number of threads parsing the input (default 1)\n");
+    printf
+	("       -w WIDTH - width of node IDs in the edge index [32/64] (default 32)\n");
+    printf
+	("       -z - compress the edge index (delta/varint encoded node indices)\n\n");
 
     exit(EXIT_FAILURE);
 }
@@ -104,29 +150,170 @@ void NidxWriteLogFile(NIDX_IO_SET * pt_ioset)
     fputs(" Netidx Log *\n", fp);
     fputs("*************\n", fp);
     fprintf(fp, " InputFile          %s\n", pt_ioset->infile);
+    if (pt_ioset->append)
+	fputs(" IndexMode          Append\n", fp);
+    if (pt_ioset->memory)
+	fprintf(fp, " IndexMode          External (%llu MB)\n",
+		pt_ioset->memory >> 20);
     fprintf(fp, " WeightType         %s\n", str_weight_type);
     fprintf(fp, " WeightCutoff       %f\n", pt_ioset->weight_cutoff);
     fprintf(fp, " NumNodes           %d\n", pt_ioset->n_nodes);
-    fprintf(fp, " NumEdges           %d\n", pt_ioset->n_edges);
-    fprintf(fp, " NumEdgesPassed     %d\n", pt_ioset->n_edges_passed);
+    fprintf(fp, " NumEdges           %llu\n", pt_ioset->n_edges);
+    fprintf(fp, " NumEdgesPassed     %llu\n", pt_ioset->n_edges_passed);
+    if (pt_ioset->compact)
+	fprintf(fp, " NumEdgesForest     %llu\n", pt_ioset->n_edges_forest);
+    if (pt_ioset->weight_width)
+	fprintf(fp, " WeightCodes        %d bits (%s)\n",
+		8 * pt_ioset->weight_width,
+		pt_ioset->n_codes ? "table" : "linear");
     fprintf(fp, " OutputLogFile      %s\n", pt_ioset->outfile_log);
     fprintf(fp, " OutputNidxFile     %s\n", pt_ioset->outfile_nidx);
     fprintf(fp, " OutputEidxFile     %s\n", pt_ioset->outfile_eidx);
     fprintf(fp, " OutputSubeFile     %s\n\n", pt_ioset->outfile_sube);
+    WritePhaseLog(fp, &pt_ioset->phases);
 
     FCLOSE(fp, pt_ioset->outfile_log);
 }
 
+/* write the indexing summary & phases into a JSON log file */
+void NidxWriteJsonLog(NIDX_IO_SET * pt_ioset)
+{
+    FILE *fp;
+
+    FOPEN(fp, pt_ioset->outfile_json, "w");
+
+    fputs("{\n  \"program\": \"netindex\",\n  \"input_file\": ", fp);
+    WriteJsonString(fp, pt_ioset->infile);
+    fprintf(fp, ",\n  \"index_mode\": \"%s\",\n",
+	    pt_ioset->append ? "append" : pt_ioset->memory ? "external" :
+	    "new");
+    if (pt_ioset->memory)
+	fprintf(fp, "  \"memory_mb\": %llu,\n", pt_ioset->memory >> 20);
+    fprintf(fp, "  \"weight_type\": \"%s\",\n",
+	    pt_ioset->weight_type ? "distance" : "similarity");
+    fprintf(fp, "  \"weight_cutoff\": %f,\n", pt_ioset->weight_cutoff);
+    fprintf(fp, "  \"threads\": %u,\n", pt_ioset->n_threads);
+    fprintf(fp, "  \"num_nodes\": %u,\n", pt_ioset->n_nodes);
+    fprintf(fp, "  \"num_edges\": %llu,\n", pt_ioset->n_edges);
+    fprintf(fp, "  \"num_edges_passed\": %llu,\n",
+	    pt_ioset->n_edges_passed);
+    if (pt_ioset->compact)
+	fprintf(fp, "  \"num_edges_forest\": %llu,\n",
+		pt_ioset->n_edges_forest);
+    fputs("  \"output_nidx_file\": ", fp);
+    WriteJsonString(fp, pt_ioset->outfile_nidx);
+    fputs(",\n  \"output_eidx_file\": ", fp);
+    WriteJsonString(fp, pt_ioset->outfile_eidx);
+    fputs(",\n  \"output_sube_file\": ", fp);
+    WriteJsonString(fp, pt_ioset->outfile_sube);
+    fputs(",\n", fp);
+    WritePhaseJson(fp, &pt_ioset->phases);
+    fputs("}\n", fp);
+
+    FCLOSE(fp, pt_ioset->outfile_json);
+}
+
 /* set I/O file names */
-NIDX_IO_SET NidxStoreIOset(int argc, char **args)
+NIDX_IO_SET NidxStoreIOset(int argc, char **argv)
 {
     unsigned int weight_type;
+    unsigned int compact;
+    unsigned int sort;
+    unsigned int compress;
+    unsigned int weight_width;
+    unsigned int id_width;
+    unsigned int json;
+    unsigned int subset;
+    unsigned long long memory;
+    int opt, n_threads, interval;
     float weight_cutoff;
     char infile[255];
+    char *index_file;
+    char **args;
     NIDX_IO_SET ioset;
 
     /* init variables */
     weight_type = 0;
+    compact = 0;
+    sort = 0;
+    compress = 0;
+    weight_width = 0;
+    n_threads = 1;
+    id_width = sizeof(unsigned int);
+    json = 0;
+    subset = 0;
+    memory = 0;
+    interval = 0;
+    index_file = NULL;
+
+    /* parse options */
+    while ((opt = getopt(argc, argv, "a:efjm:p:q:st:w:z")) != -1) {
+	switch (opt) {
+	case 'a':
+	    index_file = optarg;
+	    break;
+	case 'e':
+	    subset = 1;
+	    break;
+	case 'f':
+	    compact = 1;
+	    break;
+	case 'j':
+	    json = 1;
+	    break;
+	case 'm':
+	    if ((memory = strtoull(optarg, NULL, 10)) < EXT_MIN_MEMORY)
+		NidxUsage();
+	    memory <<= 20;
+	    break;
+	case 'p':
+	    if ((interval = atoi(optarg)) < 1)
+		NidxUsage();
+	    break;
+	case 'q':
+	    if (!strcmp(optarg, "8"))
+		weight_width = 1;
+	    else if (!strcmp(optarg, "16"))
+		weight_width = 2;
+	    else
+		NidxUsage();
+	    break;
+	case 's':
+	    sort = 1;
+	    break;
+	case 't':
+	    if ((n_threads = atoi(optarg)) < 1 || n_threads > MAX_THREADS)
+		NidxUsage();
+	    break;
+	case 'w':
+	    if (!strcmp(optarg, "32"))
+		id_width = 4;
+	    else if (!strcmp(optarg, "64"))
+		id_width = 8;
+	    else
+		NidxUsage();
+	    break;
+	case 'z':
+	    compress = 1;
+	    break;
+	default:
+	    NidxUsage();
+	}
+    }
+
+    /* shift the positional parameters so that FILE is args[1] */
+    args = argv + optind - 1;
+    argc -= optind - 1;
+
+    /* validate the number of positional parameters */
+    if (argc < 2 || argc > 4)
+	NidxUsage();
+
+    /* the layout of an existing index is kept when appending to it */
+    if (index_file != NULL && (argc > 2 || compact || sort || compress
+			       || weight_width || id_width != 4 || memory))
+	NidxUsage();
+
     strcpy(infile, args[1]);
 
     /* parse weight type (optional) */
@@ -152,296 +339,1063 @@ NIDX_IO_SET NidxStoreIOset(int argc, char **args)
     strcpy(ioset.infile, infile);
     ioset.weight_type = weight_type;
     ioset.weight_cutoff = weight_cutoff;
-
-    sprintf(ioset.outfile_nidx, "%s.nidx", infile);
-    sprintf(ioset.outfile_eidx, "%s.eidx", infile);
-    sprintf(ioset.outfile_sube, "%s.sube", infile);
+    ioset.compact = compact;
+    ioset.sort = sort;
+    ioset.compress = compress;
+    ioset.weight_width = weight_width;
+    ioset.n_codes = 0;
+    ioset.n_threads = n_threads;
+    ioset.id_width = id_width;
+    ioset.n_edges_forest = 0;
+    ioset.append = index_file != NULL;
+    ioset.eidx_size = 0;
+    ioset.json = json;
+    ioset.subset = subset;
+    ioset.memory = memory;
+    ioset.progress.interval = interval;
+
+    if (index_file == NULL)
+	index_file = infile;
+
+    sprintf(ioset.outfile_nidx, "%s.nidx", index_file);
+    sprintf(ioset.outfile_eidx, "%s.eidx", index_file);
+    if (subset)
+	sprintf(ioset.outfile_sube, "%s.sube", infile);
+    else
+	strcpy(ioset.outfile_sube, "(None)");
     sprintf(ioset.outfile_log, "%s.netindex.log", infile);
+    sprintf(ioset.outfile_json, "%s.netindex.json", infile);
+
+    /* time the phases of the run from here */
+    InitPhaseLog(&ioset.phases);
 
     return ioset;
 }
 
 /* write a header of the indexed edge file */
-void WriteFileEidxHeader(FILE * fp, char *file_name)
+void WriteFileEidxHeader(FILE * fp, char *file_name, EIDX_HEADER * header)
 {
-    unsigned int num_edges = 0;
-
-    /* reserve 4 bytes for total number of edges */
-    FWRITE(fp, file_name, &num_edges, sizeof(unsigned int));
+    /* the number of edges is updated at the end */
+    FWRITE(fp, file_name, header, sizeof(EIDX_HEADER));
 }
 
 /* update header of the indexed edge file */
-void UpdateFileEidxHeader(FILE * fp, char *file_name,
-			  unsigned int num_edges)
+void UpdateFileEidxHeader(FILE * fp, char *file_name, EIDX_HEADER * header)
 {
     /* rewind file position indicator */
     rewind(fp);
 
-    /* write total number of nodes into header */
-    FWRITE(fp, file_name, &num_edges, sizeof(int));
+    /* write total number of edges into header */
+    FWRITE(fp, file_name, header, sizeof(EIDX_HEADER));
 }
 
 /* write node index file - header */
-void WriteFileNidxHeader(FILE * fp, char *file_name,
-			 unsigned int node_buffer_size)
+void WriteFileNidxHeader(FILE * fp, char *file_name, NIDX_HEADER * header)
 {
-    unsigned int node_idx = 0;
+    /* the number of nodes & size of the labels are updated at the end */
+    FWRITE(fp, file_name, header, sizeof(NIDX_HEADER));
+}
 
-    /* reserve 4 bytes for total number of nodes */
-    FWRITE(fp, file_name, &node_idx, sizeof(int));
+/* write node index file - array of node labels */
+void WriteFileNidx(FILE_WRITER * writer, EDGE * pt_edge,
+		   HASH_TABLE * pt_table, IDX_EDGE * pt_iedge)
+{
+    unsigned int is_new;
 
-    /* write size of the node buffer (4 bytes) */
-    FWRITE(fp, file_name, &node_buffer_size, sizeof(int));
+    /* get node index A & write the label of a new node (if a file is given) */
+    pt_iedge->nodeA = AddHashKey(pt_table, pt_edge->nodeA, &is_new);
+    if (is_new && writer != NULL)
+	WriteFileBlock(writer, pt_edge->nodeA, strlen(pt_edge->nodeA) + 1);
+
+    /* get node index B & write the label of a new node */
+    pt_iedge->nodeB = AddHashKey(pt_table, pt_edge->nodeB, &is_new);
+    if (is_new && writer != NULL)
+	WriteFileBlock(writer, pt_edge->nodeB, strlen(pt_edge->nodeB) + 1);
 }
 
-/* write node index file - array of node labels */
-void WriteFileNidx(FILE * fp, char *file_name, EDGE * pt_edge,
-		   HASH_TABLE * pt_table, unsigned int *pt_node_idx)
+/* write node index file - labels of new nodes of the concurrent dictionary */
+void WriteFileNidxShards(FILE_WRITER * writer, EDGE * pt_edge,
+			 SHARD_TABLE * pt_table, unsigned int *ids,
+			 IDX_EDGE * pt_iedge)
 {
-    /* write node label A & increase the node index */
-    if (AddNewKVPToHash(pt_table, pt_edge->nodeA, *pt_node_idx) != NULL) {
-	FWRITE(fp, file_name, pt_edge->nodeA, sizeof(char) * NODE_BUF);
-	*pt_node_idx += 1;
-    }
+    unsigned int is_new;
 
-    /* write node label A & increase the node index */
-    if (AddNewKVPToHash(pt_table, pt_edge->nodeB, *pt_node_idx) != NULL) {
-	FWRITE(fp, file_name, pt_edge->nodeB, sizeof(char) * NODE_BUF);
-	*pt_node_idx += 1;
-    }
+    /* renumber the provisional IDs of the parser threads in edge order */
+    pt_iedge->nodeA = GetDenseId(pt_table, ids[0], &is_new);
+    if (is_new)
+	WriteFileBlock(writer, pt_edge->nodeA, strlen(pt_edge->nodeA) + 1);
+
+    pt_iedge->nodeB = GetDenseId(pt_table, ids[1], &is_new);
+    if (is_new)
+	WriteFileBlock(writer, pt_edge->nodeB, strlen(pt_edge->nodeB) + 1);
+}
+
+/* write node index file - offsets of the node labels */
+void WriteFileNidxOffsets(FILE * fp, char *file_name,
+			  unsigned long long *offsets, unsigned int n_nodes,
+			  unsigned long long blob_size)
+{
+    char pad[8] = { 0 };
+
+    /* align the offsets to 8 bytes */
+    if (blob_size % 8)
+	FWRITE(fp, file_name, pad, 8 - blob_size % 8);
+
+    if (n_nodes
+	&& fwrite(offsets, sizeof(unsigned long long), n_nodes,
+		  fp) != n_nodes)
+	OOPS(file_name);
 }
 
 /* update header of the node index file */
-void UpdateFileNidxHeader(FILE * fp, char *file_name,
-			  unsigned int *pt_node_idx)
+void UpdateFileNidxHeader(FILE * fp, char *file_name, NIDX_HEADER * header)
 {
     /* rewind file position indicator */
     rewind(fp);
 
-    /* write total number of nodes into header */
-    FWRITE(fp, file_name, pt_node_idx, sizeof(int));
+    /* write total number of nodes & size of the labels into header */
+    FWRITE(fp, file_name, header, sizeof(NIDX_HEADER));
 }
 
-/* create a new hash table */
-HASH_TABLE *NewHashTable(unsigned int size)
+/* remove the output files & exit with an input error */
+void AbortIndexGraph(NIDX_IO_SET * pt_ioset, char *message)
 {
-    unsigned int i;
-    HASH_TABLE *table;
-
-    if (size < 1) {
-	fputs("Error: Hash table cannot be of zero size.\n", stderr);
+    fputs(message, stderr);
+
+    /* clean-up, an existing index is cut back to its edges */
+    if (pt_ioset->append) {
+	fflush(NULL);
+	if (truncate(pt_ioset->outfile_eidx, (off_t) pt_ioset->eidx_size))
+	    OOPS(pt_ioset->outfile_eidx);
+	if (pt_ioset->subset)
+	    remove(pt_ioset->outfile_sube);
 	exit(EXIT_FAILURE);
     }
+    remove(pt_ioset->outfile_nidx);
+    remove(pt_ioset->outfile_eidx);
+    if (pt_ioset->subset)
+	remove(pt_ioset->outfile_sube);
+    exit(EXIT_FAILURE);
+}
+
+/* parse a chunk of text & add the node labels of its edges to the dictionary */
+void *ParseHashChunk(void *arg)
+{
+    unsigned int i, is_new;
+    NIDX_HASH_JOB *job;
+    TEXT_CHUNK *chunk;
 
-    /* allocate memory */
-    MALLOC(table, sizeof(HASH_TABLE));
-    MALLOC(table->table, size * sizeof(LINKED_LIST *));
+    job = (NIDX_HASH_JOB *) arg;
+    chunk = job->chunk;
 
-    /* init table */
-    for (i = 0; i < size; i++)
-	table->table[i] = NULL;
+    ParseTextChunk(chunk);
+    if (chunk->status != PARSE_OK)
+	return NULL;
 
-    /* set table size */
-    table->size = size;
+    if (2 * chunk->n_edges > job->max_ids) {
+	free(job->ids);
+	job->max_ids = 2 * chunk->max_edges;
+	MALLOC(job->ids, job->max_ids * sizeof(unsigned int));
+    }
+
+    /* the node indices are numbered in edge order once all chunks are done */
+    for (i = 0; i < chunk->n_edges; i++) {
+	job->ids[2 * i] = AddShardKey(job->table, chunk->edges[i].nodeA,
+				      &is_new);
+	job->ids[2 * i + 1] = AddShardKey(job->table, chunk->edges[i].nodeB,
+					  &is_new);
+    }
 
-    return table;
+    return NULL;
 }
 
-/* hashing function */
-unsigned int HashKeyToValue(const HASH_TABLE * pt_table, char *key)
+/* parse & hash the chunks of a block of text by a thread each */
+void ParseHashChunks(NIDX_HASH_JOB * jobs, unsigned int n_chunks)
 {
-    unsigned int value;
+    unsigned int i;
+    pthread_t thread[MAX_THREADS];
+
+    if (n_chunks == 1) {
+	ParseHashChunk(&jobs[0]);
+	return;
+    }
 
-    for (value = 0; *key != '\0'; key++)
-	value = *key + (value << 5) - value;
+    for (i = 0; i < n_chunks; i++)
+	if (pthread_create(&thread[i], NULL, ParseHashChunk, &jobs[i]))
+	    OOPS("Error: pthread_create()\n");
 
-    return value % pt_table->size;
+    for (i = 0; i < n_chunks; i++)
+	if (pthread_join(thread[i], NULL))
+	    OOPS("Error: pthread_join()\n");
 }
 
-/* lookup function for hash value */
-unsigned int *GetHashValue(HASH_TABLE * pt_table, char *key)
+/*
+ * Index the edges of the input file into the open index files. The indexing
+ * is a pipeline: a reader thread reads the blocks of text ahead, the blocks
+ * are parsed (by several threads) & hashed in turn, and a writer thread per
+ * output file writes its blocks of output, so that reading & writing overlap
+ * with parsing. Several threads also hash the labels of their chunks into a
+ * shared dictionary (shards), leaving only the numbering of the node indices
+ * to the edge order.
+ */
+void IndexEdges(NIDX_IO_SET * pt_ioset, HASH_TABLE * pt_table,
+		SHARD_TABLE * shards, EXT_DICT * ext, FILE * fp_outfile_nidx,
+		FILE * fp_outfile_sube, EIDX_WRITER * writer)
 {
-    unsigned int value;
-    LINKED_LIST *list;
+    unsigned long long n_edges;
+    unsigned long long n_edges_skipped;
+    unsigned long long n_bytes;
+    unsigned int i, j, n, n_chunks;
+    char str_weight[LINE_BUF];
+    char *message;
+    size_t size;
+    char *text;
+    EDGE *pt_edge;
+    IDX_EDGE iedge, *pt_iedge;
+    TEXT_READER *reader;
+    TEXT_CHUNK chunks[MAX_THREADS];
+    NIDX_HASH_JOB jobs[MAX_THREADS];
+    FILE_WRITER *nidx_writer, *eidx_writer, *sube_writer;
 
-    value = HashKeyToValue(pt_table, key);
+    /* set variables */
+    n_edges = 0;
+    n_edges_skipped = 0;
+    n_bytes = 0;
+    pt_iedge = &iedge;
 
-    for (list = pt_table->table[value]; list != NULL; list = list->next) {
-	if (strcmp(key, list->key) == 0) {
-	    return &list->value;
-	}
+    for (i = 0; i < pt_ioset->n_threads; i++) {
+	chunks[i].weight_type = pt_ioset->weight_type;
+	chunks[i].weight_cutoff = pt_ioset->weight_cutoff;
+	chunks[i].max_edges = 0;
+	chunks[i].edges = NULL;
+	jobs[i].chunk = &chunks[i];
+	jobs[i].table = shards;
+	jobs[i].ids = NULL;
+	jobs[i].max_ids = 0;
     }
-    return NULL;
-}
 
-/* add a key-value pair (KVP) to a hash table */
-char *AddNewKVPToHash(HASH_TABLE * pt_table, char *key, unsigned int value)
-{
-    unsigned int hash_value;
-    LINKED_LIST *new_list;
+    reader = OpenTextReader(pt_ioset->infile);
+    pt_ioset->progress.total_edges = 0;
+    pt_ioset->progress.total_bytes = GetStreamSize(reader->fp);
+    StartProgress(&pt_ioset->progress, "Indexing");
+
+    /* the threads of the pipeline leave SIGUSR1 to the progress reporter */
+    StartTextReader(reader);
+    nidx_writer = fp_outfile_nidx != NULL ?
+	OpenFileWriter(fp_outfile_nidx, pt_ioset->outfile_nidx, NULL) : NULL;
+    eidx_writer = ext == NULL ?
+	OpenFileWriter(writer->fp, pt_ioset->outfile_eidx, writer) : NULL;
+    sube_writer = fp_outfile_sube != NULL ?
+	OpenFileWriter(fp_outfile_sube, pt_ioset->outfile_sube, NULL) : NULL;
+
+    /* read input file in blocks of lines parsed by several threads */
+    while ((size = ReadTextBlock(reader, &text)) != 0) {
+	n_chunks = SplitTextBlock(text, size, chunks, pt_ioset->n_threads);
+	if (shards != NULL)
+	    ParseHashChunks(jobs, n_chunks);
+	else
+	    ParseTextChunks(chunks, n_chunks);
+
+	/* index the parsed edges in input order */
+	for (i = 0; i < n_chunks; i++) {
+	    switch (chunks[i].status) {
+	    case PARSE_FORMAT:
+		message = "Error: Input file format is incorrect!\n";
+		break;
+	    case PARSE_RANGE:
+		if (pt_ioset->weight_type)
+		    message =
+			"Input error: Edge weighes (distances) out of range.\n";
+		else
+		    message =
+			"Input error: Edge weights (similarities) cannot have negative values.\n";
+		break;
+	    default:
+		message = NULL;
+	    }
+
+	    /* the writers finish before the output is removed */
+	    if (message != NULL) {
+		if (nidx_writer != NULL)
+		    CloseFileWriter(nidx_writer);
+		if (eidx_writer != NULL)
+		    CloseFileWriter(eidx_writer);
+		if (sube_writer != NULL)
+		    CloseFileWriter(sube_writer);
+		if (ext != NULL)
+		    CloseExtDict(ext);
+		AbortIndexGraph(pt_ioset, message);
+	    }
 
-    if (GetHashValue(pt_table, key) == NULL) {	/* add KVP if new key found */
-	/* allocate memory for the list */
-	MALLOC(new_list, sizeof(LINKED_LIST));
+	    n_edges += chunks[i].n_lines;
+	    n_edges_skipped += chunks[i].n_lines - chunks[i].n_edges;
+
+	    for (j = 0; j < chunks[i].n_edges; j++) {
+		pt_edge = &chunks[i].edges[j];
+
+		/* update the progress every few edges (bytes in proportion) */
+		if (j % PROGRESS_STEP == 0) {
+		    pt_ioset->progress.n_edges = n_edges -
+			chunks[i].n_lines + j;
+		    pt_ioset->progress.n_bytes = n_bytes +
+			(chunks[i].text - text) +
+			chunks[i].size * j / chunks[i].n_edges;
+		    pt_ioset->progress.n_nodes = pt_table != NULL ?
+			pt_table->n_keys : shards != NULL ? shards->n_keys : 0;
+		}
 
-	/* get hash value of the key */
-	hash_value = HashKeyToValue(pt_table, key);
+		/* write a subset of edges into file ("%s\t%s\t%f\n", optional) */
+		if (sube_writer != NULL) {
+		    n = FormatFixedWeight(str_weight, pt_edge->weight);
+		    str_weight[n++] = '\n';
+		    WriteFileBlock(sube_writer, pt_edge->nodeA,
+				   strlen(pt_edge->nodeA));
+		    WriteFileBlock(sube_writer, "\t", 1);
+		    WriteFileBlock(sube_writer, pt_edge->nodeB,
+				   strlen(pt_edge->nodeB));
+		    WriteFileBlock(sube_writer, "\t", 1);
+		    WriteFileBlock(sube_writer, str_weight, n);
+		}
 
-	/* update hash table */
-	if ((new_list->key = (char *) strdup(key)) == NULL) {
-	    fputs("Error: strdup() returned NULL. Out of memory!\n",
-		  stderr);
-	    exit(EXIT_FAILURE);
+		/* keep the labels for the dictionary on disk (if any) */
+		if (ext != NULL) {
+		    AddExtEdge(ext, pt_edge);
+		    continue;
+		}
+
+		/* write node indices into file & set IDX_EDGE structure */
+		if (shards != NULL)
+		    WriteFileNidxShards(nidx_writer, pt_edge, shards,
+					&jobs[i].ids[2 * j], pt_iedge);
+		else
+		    WriteFileNidx(nidx_writer, pt_edge, pt_table, pt_iedge);
+		pt_iedge->weight = pt_edge->weight;
+
+		/* write indexed edges into file */
+		WriteFileBlock(eidx_writer, pt_iedge, sizeof(IDX_EDGE));
+	    }
 	}
 
-	new_list->value = value;
-	new_list->next = pt_table->table[hash_value];
-	pt_table->table[hash_value] = new_list;
+	n_bytes += size;
+    }
 
-	return key;
-    } else {
-	return NULL;
+    if (nidx_writer != NULL)
+	CloseFileWriter(nidx_writer);
+    if (eidx_writer != NULL)
+	CloseFileWriter(eidx_writer);
+    if (sube_writer != NULL)
+	CloseFileWriter(sube_writer);
+    StopProgress(&pt_ioset->progress);
+
+    for (i = 0; i < pt_ioset->n_threads; i++) {
+	free(chunks[i].edges);
+	free(jobs[i].ids);
     }
+
+    CloseTextReader(reader);
+    EndPhase(&pt_ioset->phases, "index", n_edges, 0);
+
+    /* set I/O parameters */
+    pt_ioset->n_nodes = NODE_IDX + (pt_table != NULL ? pt_table->n_keys :
+				    shards != NULL ? shards->n_keys : 0);
+    pt_ioset->n_edges = n_edges;
+    pt_ioset->n_edges_passed = n_edges - n_edges_skipped;
 }
 
 void IndexGraph(NIDX_IO_SET * pt_ioset)
 {
     /* declare variables */
-    unsigned int n_edges;
-    unsigned int n_edges_skipped;
-    unsigned int node_idx;
-    float weight;
-    float weight_cutoff;
-    char line[LINE_BUF];
-    char nodeA[NODE_BUF];
-    char nodeB[NODE_BUF];
+    unsigned long long blob_size;
+    NIDX_HEADER nidx_header;
+    EIDX_HEADER eidx_header;
     HASH_TABLE *pt_table;
-    EDGE edge, *pt_edge;
-    IDX_EDGE iedge, *pt_iedge;
-    FILE *fp_infile;
+    SHARD_TABLE *shards;
     FILE *fp_outfile_nidx;
     FILE *fp_outfile_eidx;
+    EIDX_WRITER *writer;
     FILE *fp_outfile_sube;
+    EXT_DICT *ext;
+    char message[LINE_BUF];
+
+    /*
+     * The dictionary of node labels is on disk, in memory or, with several
+     * threads, in memory & shared by the parser threads.
+     */
+    pt_table = NULL;
+    shards = NULL;
+    ext = NULL;
+    if (pt_ioset->memory)
+	ext = OpenExtDict(pt_ioset->outfile_eidx, pt_ioset->memory);
+    else if (pt_ioset->n_threads > 1)
+	shards = NewShardTable(HASH_SHARDS, HASH_TABLE_SZ);
+    else
+	pt_table = NewHashTable(HASH_TABLE_SZ);
 
-    /* set variables */
-    n_edges = 0;
-    n_edges_skipped = 0;
-    node_idx = NODE_IDX;
-    pt_edge = &edge;
-    pt_iedge = &iedge;
-    pt_table = NewHashTable(HASH_TABLE_SZ);
-    weight_cutoff = pt_ioset->weight_cutoff;
-
-    /* open I/O files for reading & writing */
-    FOPEN(fp_infile, pt_ioset->infile, "rb");
+    /* open output files for writing */
     FOPEN(fp_outfile_nidx, pt_ioset->outfile_nidx, "wb");
     FOPEN(fp_outfile_eidx, pt_ioset->outfile_eidx, "wb");
-    FOPEN(fp_outfile_sube, pt_ioset->outfile_sube, "wb");
+    fp_outfile_sube = NULL;
+    if (pt_ioset->subset)
+	FOPEN(fp_outfile_sube, pt_ioset->outfile_sube, "wb");
 
     /* write header into node index file */
-    WriteFileNidxHeader(fp_outfile_nidx, pt_ioset->outfile_nidx, NODE_BUF);
+    InitNidxHeader(&nidx_header);
+    WriteFileNidxHeader(fp_outfile_nidx, pt_ioset->outfile_nidx,
+			&nidx_header);
 
     /* write header into edge index file */
-    WriteFileEidxHeader(fp_outfile_eidx, pt_ioset->outfile_eidx);
-
-    /* read input file - To-do: put this block into a function to reduce overhead */
-    while (fgets(line, LINE_BUF, fp_infile) != NULL) {
-	/* parse input file with two or three columns */
-	if (sscanf(line, "%s %s %f\n", nodeA, nodeB, &weight) == 3) {
-	    n_edges++;
-
-	    /* filter edges depending on weight type */
-	    if (pt_ioset->weight_type) {	/* if distance values */
-		if (weight > 1 || weight < 0) {
-		    fputs
-			("Input error: Edge weighes (distances) out of range.\n",
-			 stderr);
-		    remove(pt_ioset->outfile_nidx);
-		    remove(pt_ioset->outfile_eidx);
-		    remove(pt_ioset->outfile_sube);
-		    exit(EXIT_FAILURE);
-		}
-		if (weight > weight_cutoff) {
-		    n_edges_skipped++;
-		    continue;
-		}
-	    } else {		/* if similarity values */
-
-		if (weight < 0) {
-		    fputs
-			("Input error: Edge weights (similarities) cannot have negative values.\n",
-			 stderr);
-		    remove(pt_ioset->outfile_nidx);
-		    remove(pt_ioset->outfile_eidx);
-		    remove(pt_ioset->outfile_sube);
-		    exit(EXIT_FAILURE);
-		}
-
-		if (weight < weight_cutoff) {
-		    n_edges_skipped++;
-		    continue;
-		}
-	    }
-
-	    /* set EDGE structure */
-	    strcpy(pt_edge->nodeA, nodeA);
-	    strcpy(pt_edge->nodeB, nodeB);
-	    pt_edge->weight = weight;
-
-	    /* write a subset of edges into file */
-	    fprintf(fp_outfile_sube, "%s\t%s\t%f\n", nodeA, nodeB, weight);
-
-	    /* write node indices into file */
-	    WriteFileNidx(fp_outfile_nidx, pt_ioset->outfile_nidx, pt_edge,
-			  pt_table, &node_idx);
-
-	    /* set IDX_EDGE structure */
-	    pt_iedge->nodeA = *GetHashValue(pt_table, nodeA);
-	    pt_iedge->nodeB = *GetHashValue(pt_table, nodeB);
-	    pt_iedge->weight = weight;
+    InitEidxHeader(&eidx_header, pt_ioset->id_width, pt_ioset->weight_type,
+		   pt_ioset->weight_cutoff);
+    if (pt_ioset->compress)
+	eidx_header.flags |= EIDX_COMPRESSED;
+    WriteFileEidxHeader(fp_outfile_eidx, pt_ioset->outfile_eidx,
+			&eidx_header);
+    writer = OpenEidxWriter(fp_outfile_eidx, pt_ioset->outfile_eidx,
+			    &eidx_header, NULL);
+
+    IndexEdges(pt_ioset, pt_table, shards, ext,
+	       ext == NULL ? fp_outfile_nidx : NULL, fp_outfile_sube, writer);
+
+    if (ext != NULL) {
+	/* the budget must hold the node indices of a bucket of edges */
+	if (GetExtMinMemory(ext) > pt_ioset->memory >> 20) {
+	    sprintf(message,
+		    "Error: Memory budget too small for %llu edges (-m %llu).\n",
+		    ext->n_edges, GetExtMinMemory(ext));
+	    CloseExtDict(ext);
+	    CloseEidxWriter(writer);
+	    AbortIndexGraph(pt_ioset, message);
+	}
 
-	    /* write indexed edges into file */
-	    FWRITE(fp_outfile_eidx, pt_ioset->outfile_eidx, pt_iedge,
-		   sizeof(IDX_EDGE));
+	/* number the sorted labels & rewrite the edges to node indices */
+	pt_ioset->n_nodes = NODE_IDX +
+	    BuildExtIndex(ext, fp_outfile_nidx, pt_ioset->outfile_nidx,
+			  writer);
+	blob_size = ext->blob_size;
+	CloseExtDict(ext);
+	CloseEidxWriter(writer);
+	EndPhase(&pt_ioset->phases, "merge", pt_ioset->n_edges_passed, 0);
+    } else {
+	CloseEidxWriter(writer);
+
+	/*
+	 * The labels were written in the order of their node indices, so
+	 * their offsets in the file are the offsets in the key arena (or of
+	 * the dense IDs of the shared dictionary).
+	 */
+	if (shards != NULL) {
+	    blob_size = shards->arena_used;
+	    WriteFileNidxOffsets(fp_outfile_nidx, pt_ioset->outfile_nidx,
+				 shards->offsets, pt_ioset->n_nodes,
+				 blob_size);
+	    FreeShardTable(shards);
 	} else {
-	    fputs("Error: Input file format is incorrect!\n", stderr);
-
-	    /* clean-up */
-	    remove(pt_ioset->outfile_nidx);
-	    remove(pt_ioset->outfile_eidx);
-	    remove(pt_ioset->outfile_sube);
-	    exit(EXIT_FAILURE);
+	    blob_size = pt_table->arena_used;
+	    WriteFileNidxOffsets(fp_outfile_nidx, pt_ioset->outfile_nidx,
+				 pt_table->offsets, pt_ioset->n_nodes,
+				 blob_size);
+	    FreeHashTable(pt_table);
 	}
     }
 
     /* remove file(s) depending on the indexing results */
-    if (n_edges == n_edges_skipped) {	/* if no edges left after filtering */
+    if (!pt_ioset->n_edges_passed) {	/* if no edges left after filtering */
 	remove(pt_ioset->outfile_nidx);
 	remove(pt_ioset->outfile_eidx);
-	remove(pt_ioset->outfile_sube);
+	if (fp_outfile_sube != NULL)
+	    remove(pt_ioset->outfile_sube);
 
 	strcpy(pt_ioset->outfile_nidx, "(None)");
 	strcpy(pt_ioset->outfile_eidx, "(None)");
 	strcpy(pt_ioset->outfile_sube, "(None)");
-    } else if (!n_edges_skipped) {	/* if input & output graphs are the same */
+    } else if (pt_ioset->n_edges_passed == pt_ioset->n_edges && fp_outfile_sube != NULL) {	/* if input & output graphs are the same */
 	remove(pt_ioset->outfile_sube);
 	strcpy(pt_ioset->outfile_sube, "(None)");
     }
 
     /* update node index file */
+    nidx_header.n_nodes = pt_ioset->n_nodes;
+    nidx_header.blob_size = blob_size;
     UpdateFileNidxHeader(fp_outfile_nidx, pt_ioset->outfile_nidx,
-			 &node_idx);
+			 &nidx_header);
+    eidx_header.n_edges = pt_ioset->n_edges_passed;
     UpdateFileEidxHeader(fp_outfile_eidx, pt_ioset->outfile_eidx,
-			 n_edges - n_edges_skipped);
+			 &eidx_header);
 
-    /* set I/O parameters */
-    pt_ioset->n_nodes = node_idx;
-    pt_ioset->n_edges = n_edges;
-    pt_ioset->n_edges_passed = n_edges - n_edges_skipped;
+    /* close output files */
+    FCLOSE(fp_outfile_nidx, pt_ioset->outfile_nidx);
+    FCLOSE(fp_outfile_eidx, pt_ioset->outfile_eidx);
+    if (fp_outfile_sube != NULL)
+	FCLOSE(fp_outfile_sube, pt_ioset->outfile_sube);
+}
 
-    /* close I/O files */
-    FCLOSE(fp_infile, pt_ioset->infile);
+/* append the edges of the input file to an existing index */
+void AppendGraph(NIDX_IO_SET * pt_ioset)
+{
+    /* declare variables */
+    char tmp_file[BUF + 4];
+    unsigned long long blob_size;
+    unsigned int i, is_new;
+    off_t eidx_size;
+    NIDX_HEADER nidx_header;
+    EIDX_HEADER eidx_header;
+    NIDX_TABLE nidx_table;
+    EIDX_READER *reader;
+    HASH_TABLE *pt_table;
+    FILE *fp_outfile_nidx;
+    FILE *fp_outfile_eidx;
+    EIDX_WRITER *writer;
+    FILE *fp_outfile_sube;
+
+    /* the edge index must be versioned & hold the weights as floats */
+    reader = OpenEidxReader(pt_ioset->outfile_eidx);
+    eidx_header = reader->header;
+    CloseEidxReader(reader);
+
+    if (eidx_header.version < INDEX_VERSION)
+	ExitIndexError(pt_ioset->outfile_eidx,
+		       "has an unversioned format, index the whole graph.");
+    if (eidx_header.weight_width != sizeof(float))
+	ExitIndexError(pt_ioset->outfile_eidx,
+		       "has quantized weights, index the whole graph.");
+
+    /* the edges of the input file are filtered like those of the index */
+    pt_ioset->weight_type = eidx_header.weight_type;
+    pt_ioset->weight_cutoff = eidx_header.weight_cutoff;
+
+    /* the node index must be versioned too */
+    FOPEN(fp_outfile_nidx, pt_ioset->outfile_nidx, "rb");
+    if (fread(&nidx_header, sizeof(NIDX_HEADER), 1, fp_outfile_nidx) != 1
+	|| memcmp(nidx_header.magic, NIDX_MAGIC, INDEX_MAGIC_SZ))
+	ExitIndexError(pt_ioset->outfile_nidx,
+		       "has an unversioned format, index the whole graph.");
     FCLOSE(fp_outfile_nidx, pt_ioset->outfile_nidx);
+    CheckIndexVersion(pt_ioset->outfile_nidx, nidx_header.version,
+		      nidx_header.byte_order);
+
+    /*
+     * Rebuild the dictionary from the node labels in the order of their
+     * indices, so that the key arena is the label blob of the file.
+     */
+    OpenNidxTable(&nidx_table, pt_ioset->outfile_nidx);
+    pt_table = NewHashTable(nidx_table.table_size > HASH_TABLE_SZ / 2 ?
+			    2 * nidx_table.table_size : HASH_TABLE_SZ);
+    for (i = 0; i < nidx_table.table_size; i++)
+	AddHashKey(pt_table, nidx_table.labels + nidx_table.offsets[i],
+		   &is_new);
+    blob_size = pt_table->arena_used;
+
+    if (pt_table->n_keys != nidx_table.table_size
+	|| blob_size != nidx_header.blob_size)
+	ExitIndexError(pt_ioset->outfile_nidx, "is corrupted.");
+    CloseNidxTable(&nidx_table);
+
+    /* append the indexed edges to the edge index */
+    FOPEN(fp_outfile_eidx, pt_ioset->outfile_eidx, "r+b");
+    if (fseeko(fp_outfile_eidx, 0, SEEK_END) || (eidx_size =
+						  ftello(fp_outfile_eidx)) < 0)
+	OOPS(pt_ioset->outfile_eidx);
+    pt_ioset->eidx_size = eidx_size;
+    fp_outfile_sube = NULL;
+    if (pt_ioset->subset)
+	FOPEN(fp_outfile_sube, pt_ioset->outfile_sube, "wb");
+    writer = OpenEidxWriter(fp_outfile_eidx, pt_ioset->outfile_eidx,
+			    &eidx_header, NULL);
+
+    IndexEdges(pt_ioset, pt_table, NULL, NULL, NULL, fp_outfile_sube,
+	       writer);
+    CloseEidxWriter(writer);
+
+    /* remove the subset of edges unless some edges were skipped */
+    if (fp_outfile_sube != NULL && (!pt_ioset->n_edges_passed
+				     || pt_ioset->n_edges_passed ==
+				     pt_ioset->n_edges)) {
+	remove(pt_ioset->outfile_sube);
+	strcpy(pt_ioset->outfile_sube, "(None)");
+    }
+
+    /*
+     * Write the node index with the labels of new nodes next to the original
+     * one & replace it, so that a failure leaves the old node index readable.
+     */
+    nidx_header.n_nodes = pt_ioset->n_nodes;
+    nidx_header.blob_size = pt_table->arena_used;
+    sprintf(tmp_file, "%s.tmp", pt_ioset->outfile_nidx);
+    FOPEN(fp_outfile_nidx, tmp_file, "wb");
+    WriteFileNidxHeader(fp_outfile_nidx, tmp_file, &nidx_header);
+    if (pt_table->arena_used)
+	FWRITE(fp_outfile_nidx, tmp_file, pt_table->arena,
+	       pt_table->arena_used);
+    WriteFileNidxOffsets(fp_outfile_nidx, tmp_file, pt_table->offsets,
+			 pt_ioset->n_nodes, pt_table->arena_used);
+    FCLOSE(fp_outfile_nidx, tmp_file);
+
+    if (rename(tmp_file, pt_ioset->outfile_nidx))
+	OOPS(pt_ioset->outfile_nidx);
+    FreeHashTable(pt_table);
+
+    /*
+     * The appended edges are not in the order of the weight marks; the marks
+     * stay before data_offset, which readers skip to.
+     */
+    eidx_header.n_edges += pt_ioset->n_edges_passed;
+    if (pt_ioset->n_edges_passed) {
+	eidx_header.flags &= ~EIDX_SORTED;
+	eidx_header.n_marks = 0;
+    }
+    UpdateFileEidxHeader(fp_outfile_eidx, pt_ioset->outfile_eidx,
+			 &eidx_header);
+
+    /* close output files */
     FCLOSE(fp_outfile_eidx, pt_ioset->outfile_eidx);
-    FCLOSE(fp_outfile_sube, pt_ioset->outfile_sube);
+    if (fp_outfile_sube != NULL)
+	FCLOSE(fp_outfile_sube, pt_ioset->outfile_sube);
+}
+
+/* reduce a buffer of edges to its spanning forest (Kruskal's algorithm) */
+unsigned long long ReduceToForest(IDX_EDGE * edges,
+				  unsigned long long n_edges,
+				  unsigned int *set, unsigned int *set_size,
+				  unsigned int n_nodes,
+				  unsigned int weight_type)
+{
+    unsigned long long i, n_kept;
+
+    for (i = 0; i < n_nodes; i++) {
+	set[i] = i;
+	set_size[i] = 1;
+    }
+
+    /* order edges from the best to the worst weight */
+    qsort(edges, n_edges, sizeof(IDX_EDGE),
+	  weight_type ? CmpByDistance : CmpBySimilarity);
+
+    /* keep only the edges that merge two trees */
+    for (i = 0, n_kept = 0; i < n_edges; i++)
+	if (UnionNodes(set, set_size, edges[i].nodeA, edges[i].nodeB))
+	    edges[n_kept++] = edges[i];
+
+    return n_kept;
+}
+
+/* rewrite the edge index with the edges of its spanning forest */
+void CompactFileEidx(NIDX_IO_SET * pt_ioset)
+{
+    unsigned long long i, m, n, n_forest, buf_size;
+    unsigned int n_nodes, *set, *set_size;
+    IDX_EDGE *edges, *block;
+    EIDX_HEADER header;
+    EIDX_READER *reader;
+    FILE *fp;
+
+    n_nodes = pt_ioset->n_nodes;
+    n_forest = 0;
+
+    /*
+     * The forest of the edges read so far never exceeds n_nodes - 1 edges,
+     * so the edges are processed in chunks appended to the current forest
+     * and the memory stays bounded regardless of the number of edges.
+     */
+    buf_size = (unsigned long long) n_nodes +
+	(n_nodes > EIDX_CHUNK ? n_nodes : EIDX_CHUNK);
+    MALLOC(edges, sizeof(IDX_EDGE) * buf_size);
+    MALLOC(set, sizeof(unsigned int) * n_nodes);
+    MALLOC(set_size, sizeof(unsigned int) * n_nodes);
+
+    reader = OpenEidxReader(pt_ioset->outfile_eidx);
+    header = reader->header;
+    header.weight_width = sizeof(float);
+    header.n_codes = 0;
+
+    while ((n = ReadEidxBlock(reader, &block)) != 0) {
+	for (i = 0; i < n; i += m) {
+	    m = buf_size - n_forest;
+	    if (m > n - i)
+		m = n - i;
+
+	    memcpy(&edges[n_forest], &block[i], sizeof(IDX_EDGE) * m);
+	    n_forest += m;
+
+	    if (n_forest == buf_size)
+		n_forest = ReduceToForest(edges, n_forest, set, set_size,
+					  n_nodes, pt_ioset->weight_type);
+	}
+    }
+    CloseEidxReader(reader);
+
+    n_forest = ReduceToForest(edges, n_forest, set, set_size, n_nodes,
+			      pt_ioset->weight_type);
+
+    /* write the forest sorted by weight (best first) */
+    FOPEN(fp, pt_ioset->outfile_eidx, "wb");
+    WriteFileEidxSorted(fp, pt_ioset->outfile_eidx, &header, edges,
+			n_forest);
+    FCLOSE(fp, pt_ioset->outfile_eidx);
+
+    pt_ioset->n_edges_forest = n_forest;
+
+    free(edges);
+    free(set);
+    free(set_size);
+}
+
+/* set up the weight marks of sorted edges, returns the step between marks */
+unsigned long long InitEidxMarks(EIDX_HEADER * header,
+				 unsigned long long n_edges,
+				 EIDX_MARK ** marks)
+{
+    unsigned long long step;
+
+    step = n_edges ? (n_edges + EIDX_MARKS - 1) / EIDX_MARKS : 1;
+
+    /* mark whole frames of a compressed index */
+    if (header->flags & EIDX_COMPRESSED)
+	step = (step + EIDX_FRAME - 1) / EIDX_FRAME * EIDX_FRAME;
+
+    header->flags |= EIDX_SORTED;
+    header->n_edges = n_edges;
+    header->n_marks = (n_edges + step - 1) / step;
+    header->data_offset =
+	sizeof(EIDX_HEADER) + header->n_marks * sizeof(EIDX_MARK);
+
+    MALLOC(*marks, sizeof(EIDX_MARK) * (header->n_marks + 1));
+    memset(*marks, 0, sizeof(EIDX_MARK) * (header->n_marks + 1));
+
+    return step;
+}
+
+/* update header & weight marks of the sorted edge index */
+void WriteFileEidxMarks(FILE * fp, char *file_name, EIDX_HEADER * header,
+			EIDX_MARK * marks)
+{
+    UpdateFileEidxHeader(fp, file_name, header);
+
+    if (header->n_marks
+	&& fwrite(marks, sizeof(EIDX_MARK), header->n_marks,
+		  fp) != header->n_marks)
+	OOPS(file_name);
+}
+
+/* write the edge index of edges sorted by weight */
+void WriteFileEidxSorted(FILE * fp, char *file_name, EIDX_HEADER * header,
+			 IDX_EDGE * edges, unsigned long long n_edges)
+{
+    unsigned long long i, step;
+    EIDX_MARK *marks;
+    EIDX_WRITER *writer;
+
+    step = InitEidxMarks(header, n_edges, &marks);
+
+    for (i = 0; i < n_edges; i += step) {
+	marks[i / step].weight = edges[i].weight;
+	marks[i / step].edge = i;
+    }
+
+    WriteFileEidxMarks(fp, file_name, header, marks);
+    writer = OpenEidxWriter(fp, file_name, header, NULL);
+    WriteEidxEdges(writer, edges, n_edges);
+    CloseEidxWriter(writer);
+
+    free(marks);
+}
+
+/* load the next edges of a sorted run from the temporary file */
+void FillEidxRun(EIDX_RUN * run, int fd, char *file_name)
+{
+    unsigned long long n;
+    ssize_t size;
+
+    n = run->end - run->next;
+    if (n > EIDX_RUN_BUF)
+	n = EIDX_RUN_BUF;
+
+    size = sizeof(IDX_EDGE) * n;
+    if (pread(fd, run->edges, size, run->next * sizeof(IDX_EDGE)) != size)
+	OOPS(file_name);
+
+    run->next += n;
+    run->pos = 0;
+    run->count = n;
+}
+
+/* restore the order of a heap of runs by their first edges */
+void SiftDownEidxRun(EIDX_RUN ** heap, unsigned int n_runs, unsigned int i,
+		     int (*cmp) (const void *, const void *))
+{
+    unsigned int child;
+    EIDX_RUN *run;
+
+    run = heap[i];
+
+    while ((child = 2 * i + 1) < n_runs) {
+	if (child + 1 < n_runs
+	    && cmp(&heap[child + 1]->edges[heap[child + 1]->pos],
+		   &heap[child]->edges[heap[child]->pos]) < 0)
+	    child++;
+
+	if (cmp(&heap[child]->edges[heap[child]->pos],
+		&run->edges[run->pos]) >= 0)
+	    break;
+
+	heap[i] = heap[child];
+	i = child;
+    }
+
+    heap[i] = run;
+}
+
+/* rewrite the edge index sorted by weight (best first) */
+void SortFileEidx(NIDX_IO_SET * pt_ioset)
+{
+    unsigned long long i, k, m, n, n_edges, step;
+    unsigned int r, n_runs, n_heap;
+    int (*cmp) (const void *, const void *);
+    char tmp_file[BUF + 4];
+    IDX_EDGE *edges, *block;
+    EIDX_HEADER header;
+    EIDX_MARK *marks;
+    EIDX_RUN *runs, **heap;
+    EIDX_READER *reader;
+    EIDX_WRITER *writer;
+    FILE *fp, *fp_tmp;
+
+    cmp = pt_ioset->weight_type ? CmpByDistance : CmpBySimilarity;
+    sprintf(tmp_file, "%s.tmp", pt_ioset->outfile_eidx);
+    fp_tmp = NULL;
+    n_runs = 0;
+    n = 0;
+
+    reader = OpenEidxReader(pt_ioset->outfile_eidx);
+    header = reader->header;
+    header.weight_width = sizeof(float);
+    header.n_codes = 0;
+    n_edges = header.n_edges;
+    MALLOC(edges, sizeof(IDX_EDGE) *
+	   (n_edges < EIDX_CHUNK ? n_edges + 1 : EIDX_CHUNK));
+
+    /*
+     * The edges are sorted in runs of EIDX_CHUNK edges; unless they all fit
+     * into a single run, the runs are spilled to a temporary file and merged.
+     */
+    while ((m = ReadEidxBlock(reader, &block)) != 0) {
+	for (i = 0; i < m; i += k) {
+	    k = EIDX_CHUNK - n;
+	    if (k > m - i)
+		k = m - i;
+
+	    memcpy(&edges[n], &block[i], sizeof(IDX_EDGE) * k);
+	    n += k;
+
+	    if (n == EIDX_CHUNK && n_runs * (unsigned long long) EIDX_CHUNK
+		+ n < n_edges) {
+		if (fp_tmp == NULL)
+		    FOPEN(fp_tmp, tmp_file, "w+b");
+		qsort(edges, n, sizeof(IDX_EDGE), cmp);
+		if (fwrite(edges, sizeof(IDX_EDGE), n, fp_tmp) != n)
+		    OOPS(tmp_file);
+		n_runs++;
+		n = 0;
+	    }
+	}
+    }
+    CloseEidxReader(reader);
+
+    qsort(edges, n, sizeof(IDX_EDGE), cmp);
+    FOPEN(fp, pt_ioset->outfile_eidx, "wb");
+
+    /* write a single run at once */
+    if (fp_tmp == NULL) {
+	WriteFileEidxSorted(fp, pt_ioset->outfile_eidx, &header, edges, n);
+	FCLOSE(fp, pt_ioset->outfile_eidx);
+	free(edges);
+	return;
+    }
+
+    if (fwrite(edges, sizeof(IDX_EDGE), n, fp_tmp) != n)
+	OOPS(tmp_file);
+    if (fflush(fp_tmp))
+	OOPS(tmp_file);
+    n_runs++;
+
+    /* set up the runs in a heap ordered by their first edges */
+    MALLOC(runs, sizeof(EIDX_RUN) * n_runs);
+    MALLOC(heap, sizeof(EIDX_RUN *) * n_runs);
+
+    for (r = 0; r < n_runs; r++) {
+	MALLOC(runs[r].edges, sizeof(IDX_EDGE) * EIDX_RUN_BUF);
+	runs[r].next = (unsigned long long) r * EIDX_CHUNK;
+	runs[r].end = runs[r].next + EIDX_CHUNK;
+	if (runs[r].end > n_edges)
+	    runs[r].end = n_edges;
+	FillEidxRun(&runs[r], fileno(fp_tmp), tmp_file);
+	heap[r] = &runs[r];
+    }
+
+    for (r = n_runs / 2; r-- > 0;)
+	SiftDownEidxRun(heap, n_runs, r, cmp);
+    n_heap = n_runs;
+
+    /* merge the runs into blocks of the edge index */
+    step = InitEidxMarks(&header, n_edges, &marks);
+    WriteFileEidxMarks(fp, pt_ioset->outfile_eidx, &header, marks);
+    writer = OpenEidxWriter(fp, pt_ioset->outfile_eidx, &header, NULL);
+
+    for (i = 0, n = 0; i < n_edges; i++) {
+	edges[n] = heap[0]->edges[heap[0]->pos++];
+
+	if (i % step == 0) {
+	    marks[i / step].weight = edges[n].weight;
+	    marks[i / step].edge = i;
+	}
+
+	if (++n == EIDX_CHUNK) {
+	    WriteEidxEdges(writer, edges, n);
+	    n = 0;
+	}
+
+	/* refill or drop the run of the written edge */
+	if (heap[0]->pos == heap[0]->count) {
+	    if (heap[0]->next < heap[0]->end)
+		FillEidxRun(heap[0], fileno(fp_tmp), tmp_file);
+	    else
+		heap[0] = heap[--n_heap];
+	}
+
+	if (n_heap)
+	    SiftDownEidxRun(heap, n_heap, 0, cmp);
+    }
+
+    WriteEidxEdges(writer, edges, n);
+    CloseEidxWriter(writer);
+    WriteFileEidxMarks(fp, pt_ioset->outfile_eidx, &header, marks);
+    FCLOSE(fp, pt_ioset->outfile_eidx);
+
+    FCLOSE(fp_tmp, tmp_file);
+    remove(tmp_file);
+
+    for (r = 0; r < n_runs; r++)
+	free(runs[r].edges);
+    free(runs);
+    free(heap);
+    free(marks);
+    free(edges);
+}
+
+/* rewrite the edge index with weights quantized to codes of a given width */
+void QuantizeFileEidx(NIDX_IO_SET * pt_ioset)
+{
+    unsigned long long i, n;
+    unsigned int n_codes, max_codes, mask, bits, slot, *slots;
+    float weight, min_weight, max_weight, *table, *codes;
+    char tmp_file[BUF + 4];
+    IDX_EDGE *edges;
+    EIDX_HEADER header;
+    EIDX_MARK *marks;
+    EIDX_READER *reader;
+    EIDX_WRITER *writer;
+    FILE *fp;
+
+    max_codes = EIDX_CODES(pt_ioset->weight_width);
+    n_codes = 0;
+    min_weight = FLT_MAX;
+    max_weight = -FLT_MAX;
+
+    /* hash set of the bits of distinct weights, at most a quarter full */
+    mask = 4 * max_codes - 1;
+    MALLOC(slots, sizeof(unsigned int) * (mask + 1));
+    memset(slots, 0xff, sizeof(unsigned int) * (mask + 1));
+    MALLOC(table, sizeof(float) * max_codes);
+
+    /* collect the range & distinct weights (up to the number of codes) */
+    reader = OpenEidxReader(pt_ioset->outfile_eidx);
+
+    while ((n = ReadEidxBlock(reader, &edges)) != 0) {
+	for (i = 0; i < n; i++) {
+	    weight = edges[i].weight;
+
+	    if (weight < min_weight)
+		min_weight = weight;
+	    if (weight > max_weight)
+		max_weight = weight;
+
+	    if (n_codes > max_codes)
+		continue;
+
+	    memcpy(&bits, &weight, sizeof(float));
+	    for (slot = (bits * 2654435761U) & mask;
+		 slots[slot] != EIDX_NO_WEIGHT && slots[slot] != bits;
+		 slot = (slot + 1) & mask);
+
+	    if (slots[slot] == EIDX_NO_WEIGHT) {
+		slots[slot] = bits;
+		if (n_codes < max_codes)
+		    table[n_codes] = weight;
+		n_codes++;
+	    }
+	}
+    }
+
+    header = reader->header;
+    MALLOC(marks, sizeof(EIDX_MARK) * (header.n_marks + 1));
+    if (header.n_marks)
+	memcpy(marks, reader->marks, sizeof(EIDX_MARK) * header.n_marks);
+    CloseEidxReader(reader);
+    free(slots);
+
+    /*
+     * A table of the distinct weights keeps them exact; otherwise the weights
+     * are spread linearly over the codes. Both preserve the order of weights.
+     */
+    header.weight_width = pt_ioset->weight_width;
+
+    if (n_codes <= max_codes) {
+	qsort(table, n_codes, sizeof(float), CmpAscending);
+	header.n_codes = n_codes;
+    } else {
+	header.n_codes = 0;
+	header.weight_offset = min_weight;
+	header.weight_scale = (max_weight - min_weight) / (max_codes - 1);
+    }
+
+    codes = BuildWeightCodes(&header, table);
+    pt_ioset->n_codes = header.n_codes;
+
+    /* mark the weights as read back from the codes */
+    for (i = 0; i < header.n_marks; i++)
+	marks[i].weight =
+	    codes[EncodeWeight(marks[i].weight, codes, max_codes)];
+
+    header.data_offset = sizeof(EIDX_HEADER) +
+	header.n_marks * sizeof(EIDX_MARK) + header.n_codes * sizeof(float);
+
+    /* write the quantized index next to the original one & replace it */
+    sprintf(tmp_file, "%s.tmp", pt_ioset->outfile_eidx);
+    FOPEN(fp, tmp_file, "wb");
+    WriteFileEidxHeader(fp, tmp_file, &header);
+
+    if (header.n_marks
+	&& fwrite(marks, sizeof(EIDX_MARK), header.n_marks,
+		  fp) != header.n_marks)
+	OOPS(tmp_file);
+    if (header.n_codes
+	&& fwrite(table, sizeof(float), header.n_codes,
+		  fp) != header.n_codes)
+	OOPS(tmp_file);
+
+    reader = OpenEidxReader(pt_ioset->outfile_eidx);
+    writer = OpenEidxWriter(fp, tmp_file, &header, codes);
+
+    while ((n = ReadEidxBlock(reader, &edges)) != 0)
+	WriteEidxEdges(writer, edges, n);
+
+    CloseEidxWriter(writer);
+    CloseEidxReader(reader);
+    FCLOSE(fp, tmp_file);
+
+    if (rename(tmp_file, pt_ioset->outfile_eidx))
+	OOPS(pt_ioset->outfile_eidx);
+
+    free(marks);
+    free(table);
+    free(codes);
 }
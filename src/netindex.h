@@ -28,51 +28,94 @@
 
 #define BUF 255			/* string buffer */
 #define NODE_IDX 0		/* node indexing starts from zero */
-#define HASH_TABLE_SZ 5000000	/* hash table size */
+#define EIDX_CHUNK 16777216	/* edges per chunk for forest compaction & sorting */
+#define EIDX_RUN_BUF 16384	/* edges buffered per sorted run when merging */
+#define EIDX_NO_WEIGHT 0xffffffff	/* empty slot of distinct weights (NaN) */
 #define FWRITE(fp, fn, s, t) if(!fwrite(s, t, 1, fp)) OOPS(fn);	/* write binary file */
 
 /* typedefs */
 typedef struct _nidx_io_set NIDX_IO_SET;
-typedef struct _linked_list_ LINKED_LIST;
-typedef struct _hash_table_ HASH_TABLE;
+typedef struct _eidx_run_ EIDX_RUN;	/* sorted run of edges being merged */
+typedef struct _nidx_hash_job_ NIDX_HASH_JOB;	/* chunk parsed & hashed by a thread */
 
 struct _nidx_io_set {
     unsigned int weight_type;
+    unsigned int compact;
+    unsigned int sort;
+    unsigned int compress;
+    unsigned int weight_width;
+    unsigned int n_codes;
+    unsigned int n_threads;
+    unsigned int id_width;
+    unsigned int append;
+    unsigned int json;
+    unsigned int subset;	/* 1 if the edges passing the cutoff are written as text */
+    unsigned long long memory;	/* memory budget of a dictionary on disk (0 - in memory) */
     unsigned int n_nodes;
-    unsigned int n_edges;
-    unsigned int n_edges_passed;
+    unsigned long long n_edges;
+    unsigned long long n_edges_passed;
+    unsigned long long n_edges_forest;
+    unsigned long long eidx_size;	/* size of the edge index before appending */
     float weight_cutoff;
     char infile[BUF];
     char outfile_nidx[BUF];
     char outfile_eidx[BUF];
     char outfile_sube[BUF];
     char outfile_log[BUF];
+    char outfile_json[BUF];
+    PHASE_LOG phases;
+    PROGRESS progress;
 };
 
-struct _linked_list_ {
-    char *key;
-    unsigned int value;
-    LINKED_LIST *next;
+struct _eidx_run_ {
+    IDX_EDGE *edges;		/* buffered edges of the run */
+    unsigned int pos;		/* next buffered edge */
+    unsigned int count;		/* number of buffered edges */
+    unsigned long long next;	/* next edge of the run in the file */
+    unsigned long long end;	/* end of the run in the file */
 };
 
-struct _hash_table_ {
-    unsigned int size;
-    LINKED_LIST **table;
+struct _nidx_hash_job_ {
+    TEXT_CHUNK *chunk;		/* chunk of text & its parsed edges */
+    SHARD_TABLE *table;		/* dictionary shared by the threads */
+    unsigned int *ids;		/* provisional IDs of nodes A & B of each edge */
+    unsigned int max_ids;	/* allocated IDs */
 };
 
 /* function prototypes */
 extern void NidxUsage();
 extern NIDX_IO_SET NidxStoreIOset(int, char **);
-extern void WriteFileNidxHeader(FILE *, char *, unsigned int);
-extern void WriteFileNidx(FILE *, char *, EDGE *, HASH_TABLE *,
-			  unsigned int *);
-extern void UpdateFileNidxHeader(FILE *, char *, unsigned int *);
-extern void WriteFileEidxHeader(FILE *, char *);
-extern void UpdateFileEidxHeader(FILE *, char *, unsigned int);
-extern HASH_TABLE *NewHashTable(unsigned int);
-extern unsigned int *GetHashValue(HASH_TABLE *, char *);
-extern char *AddNewKVPToHash(HASH_TABLE *, char *, unsigned int);
+extern void WriteFileNidxHeader(FILE *, char *, NIDX_HEADER *);
+extern void WriteFileNidx(FILE_WRITER *, EDGE *, HASH_TABLE *, IDX_EDGE *);
+extern void WriteFileNidxShards(FILE_WRITER *, EDGE *, SHARD_TABLE *,
+				unsigned int *, IDX_EDGE *);
+extern void WriteFileNidxOffsets(FILE *, char *, unsigned long long *,
+				 unsigned int, unsigned long long);
+extern void UpdateFileNidxHeader(FILE *, char *, NIDX_HEADER *);
+extern void WriteFileEidxHeader(FILE *, char *, EIDX_HEADER *);
+extern void UpdateFileEidxHeader(FILE *, char *, EIDX_HEADER *);
+extern void AbortIndexGraph(NIDX_IO_SET *, char *);
+extern void *ParseHashChunk(void *);
+extern void ParseHashChunks(NIDX_HASH_JOB *, unsigned int);
+extern void IndexEdges(NIDX_IO_SET *, HASH_TABLE *, SHARD_TABLE *,
+		       EXT_DICT *, FILE *, FILE *, EIDX_WRITER *);
 extern void IndexGraph(NIDX_IO_SET *);
+extern void AppendGraph(NIDX_IO_SET *);
 extern void NidxWriteLogFile(NIDX_IO_SET *);
+extern void NidxWriteJsonLog(NIDX_IO_SET *);
+extern unsigned long long ReduceToForest(IDX_EDGE *, unsigned long long,
+					 unsigned int *, unsigned int *,
+					 unsigned int, unsigned int);
+extern void CompactFileEidx(NIDX_IO_SET *);
+extern unsigned long long InitEidxMarks(EIDX_HEADER *, unsigned long long,
+					EIDX_MARK **);
+extern void WriteFileEidxMarks(FILE *, char *, EIDX_HEADER *, EIDX_MARK *);
+extern void WriteFileEidxSorted(FILE *, char *, EIDX_HEADER *, IDX_EDGE *,
+				unsigned long long);
+extern void FillEidxRun(EIDX_RUN *, int, char *);
+extern void SiftDownEidxRun(EIDX_RUN **, unsigned int, unsigned int,
+			    int (*)(const void *, const void *));
+extern void SortFileEidx(NIDX_IO_SET *);
+extern void QuantizeFileEidx(NIDX_IO_SET *);
 
 #endif				/* NETINDEX_H */
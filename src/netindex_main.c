@@ -36,17 +36,57 @@
  *  WEIGHT TYPE - edge weights might refer to either similarity (S) or distance (D) measure (default S)
  *  WEIGHT CUTOFF - cutoff value for edge weights
  *
+ *  -a INDEX - append the edges of FILE to INDEX.nidx & INDEX.eidx, reusing the
+ *       node dictionary of INDEX.nidx & the weight type & cutoff of INDEX.eidx;
+ *       the time is proportional to the new edges (and the number of nodes)
+ *  -e - write the edges passing the cutoff as text too (*.sube); netexport
+ *       rebuilds the same text from *.nidx & *.eidx otherwise
+ *  -f - keep only the edges of the maximum (similarity) or minimum (distance) spanning
+ *       forest in *.eidx, sorted by weight (with -z, sorted by frames); single-linkage
+ *       clusters at any cutoff are the same as with the full edge index
+ *  -j - write the log as JSON too (*.netindex.json)
+ *  -m MEMORY - keep the dictionary of node labels on disk for graphs with more
+ *       labels than fit in memory: the labels are sorted in runs of about
+ *       MEMORY megabytes & merged, and the edges are rewritten to node indices
+ *       by their positions; node indices follow the order of the labels
+ *  -p SECONDS - print the edges & bytes read, nodes found, rate & estimated time
+ *       left to STDERR every SECONDS; they are printed on SIGUSR1 in any case
+ *  -q BITS - store the weights in *.eidx as 8- or 16-bit codes: a table of the
+ *       distinct weights if they fit (exact), a linear scale otherwise (the
+ *       weights are rounded, netclust warns of a cutoff between two codes)
+ *  -s - sort *.eidx by weight (best first) with marks of the weights in its
+ *       header, so that netclust reads only the edges passing a cutoff; with
+ *       -z, the frames are sorted & the edges of a frame are ordered by node
+ *       indices
+ *  -t THREADS - parse the input in newline-aligned chunks by several threads,
+ *       which hash the node labels into a shared dictionary (in shards with a
+ *       lock each); the output files are the same as with a single thread
+ *  -w WIDTH - width of node IDs in *.eidx (32 or 64 bits, default 32)
+ *  -z - compress *.eidx in frames of edges ordered by node indices, with
+ *       delta/varint encoded node indices
+ *
  *  Output files:
  * 
  *   *.nidx - a binary file of node indices
  *   *.eidx - a binary file of indexed edges
- *   *.sube - a text file containing a subset of input edges (created only if theat least one edge passes a weight threshold) 
- *   *.netindex.log - a log file with some information about a run
+ *   *.sube - a text file containing a subset of input edges (created only with
+ *       -e & if some but not all edges pass the weight threshold)
+ *   *.netindex.log - a log file with some information about a run, including
+ *       the wall & CPU time, bytes read & written, throughput & peak memory of
+ *       each phase (parsing & hashing, node index, forest, sorting, quantizing)
+ *
+ *  Both index files start with a versioned header (magic number, version, byte
+ *  order); the edge index header holds a 64-bit number of edges and the width
+ *  of node IDs. netclust reads the unversioned indices of earlier releases too.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include "net.h"
+#include "netio.h"
+#include "netparse.h"
+#include "nethash.h"
+#include "netext.h"
 #include "netindex.h"
 
 int main(int argc, char **argv)
@@ -56,17 +96,42 @@ int main(int argc, char **argv)
     pt_ioset = &ioset;
 
     /* validate the number of input parameters */
-    if (argc < 2 || argc > 4)
+    if (argc < 2)
 	NidxUsage();
 
     /* store IO parameters */
     ioset = NidxStoreIOset(argc,argv);
 
-    /* index the input graph */
-    IndexGraph(pt_ioset);
+    /* index the input graph or append it to an existing index */
+    if (pt_ioset->append)
+	AppendGraph(pt_ioset);
+    else
+	IndexGraph(pt_ioset);
+    EndPhase(&pt_ioset->phases, "nidx", 0, 0);
+
+    /* keep only the spanning forest in the edge index (optional) */
+    if (pt_ioset->compact && pt_ioset->n_edges_passed) {
+	CompactFileEidx(pt_ioset);
+	EndPhase(&pt_ioset->phases, "forest", pt_ioset->n_edges_passed, 0);
+    }
+
+    /* sort the edge index by weight (optional, the forest is sorted anyway) */
+    if (pt_ioset->sort && !pt_ioset->compact && pt_ioset->n_edges_passed) {
+	SortFileEidx(pt_ioset);
+	EndPhase(&pt_ioset->phases, "sort", pt_ioset->n_edges_passed, 0);
+    }
+
+    /* store the weights as quantized codes (optional) */
+    if (pt_ioset->weight_width && pt_ioset->n_edges_passed) {
+	QuantizeFileEidx(pt_ioset);
+	EndPhase(&pt_ioset->phases, "quantize", pt_ioset->n_edges_passed,
+		 0);
+    }
 
-    /* write log file */
+    /* write log file (and a JSON log) */
     NidxWriteLogFile(pt_ioset);
+    if (pt_ioset->json)
+	NidxWriteJsonLog(pt_ioset);
 
     exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,1066 @@
+/*
+ * File:	netio.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Reading and writing of the binary index files.
+ *
+ * The edge index is memory-mapped when it is a regular file, so that the edges
+ * are read zero-copy at memory bandwidth; otherwise (e.g. a named pipe) it is
+ * read in large blocks.
+ *
+ * Both indices start with a versioned header (see EIDX_HEADER & NIDX_HEADER in
+ * netio.h): a magic number, the format version and the byte order of the
+ * indexing host, followed by 64-bit counts. The edge index is laid out as:
+ *
+ *   [header (96 bytes)] [weight marks (16 bytes each) of a sorted index]
+ *   [code table (4 bytes per weight) of quantized weights]
+ *   [edges (2 * id_width + weight_width bytes each) from data_offset]
+ *
+ * where node IDs are 32 or 64 bits wide & weights are floats or 8/16-bit codes;
+ * other records than IDX_EDGE are decoded block by block. A compressed index
+ * holds frames of edges instead (see EIDX_WRITER). The node index is laid out
+ * as:
+ *
+ *   [header (48 bytes)] [blob of NUL-terminated labels, padded to 8 bytes]
+ *   [offsets (8 bytes per node)]
+ *
+ * The unversioned indices of earlier releases are still readable:
+ *
+ *   edges: [n_edges (4 bytes)] [edges (12 bytes each)]
+ *   nodes: [n_nodes (4 bytes)] [node buffer size (4 bytes)]
+ *          [labels (buffer size per node)]
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "netio.h"
+
+/* set up a header of the edge index */
+void InitEidxHeader(EIDX_HEADER * header, unsigned int id_width,
+		    unsigned int weight_type, float weight_cutoff)
+{
+    memset(header, 0, sizeof(EIDX_HEADER));
+    memcpy(header->magic, EIDX_MAGIC, INDEX_MAGIC_SZ);
+    header->version = INDEX_VERSION;
+    header->byte_order = BYTE_ORDER_MARK;
+    header->id_width = id_width;
+    header->data_offset = sizeof(EIDX_HEADER);
+    header->weight_width = sizeof(float);
+    header->weight_type = weight_type;
+    header->weight_cutoff = weight_cutoff;
+}
+
+/* set up a header of the node index */
+void InitNidxHeader(NIDX_HEADER * header)
+{
+    memset(header, 0, sizeof(NIDX_HEADER));
+    memcpy(header->magic, NIDX_MAGIC, INDEX_MAGIC_SZ);
+    header->version = INDEX_VERSION;
+    header->byte_order = BYTE_ORDER_MARK;
+}
+
+/* exit with an error about an index file */
+void ExitIndexError(char *file_name, char *message)
+{
+    fprintf(stderr, "Error: %s %s\n", file_name, message);
+    exit(EXIT_FAILURE);
+}
+
+/* check that an index of a given version can be read on this host */
+void CheckIndexVersion(char *file_name, unsigned int version,
+		       unsigned int byte_order)
+{
+    if (byte_order != BYTE_ORDER_MARK)
+	ExitIndexError(file_name, "was written with another byte order.");
+
+    if (version > INDEX_VERSION) {
+	fprintf(stderr, "Error: %s has an unsupported version (%u).\n",
+		file_name, version);
+	exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Get the weights of all codes of quantized weights in ascending order, given
+ * the code table of the index (if any).
+ */
+float *BuildWeightCodes(EIDX_HEADER * header, float *table)
+{
+    unsigned int i, n;
+    float *codes;
+
+    n = EIDX_CODES(header->weight_width);
+    MALLOC(codes, sizeof(float) * n);
+
+    for (i = 0; i < n; i++) {
+	if (!header->n_codes)
+	    codes[i] = header->weight_offset + i * header->weight_scale;
+	else if (i < header->n_codes)
+	    codes[i] = table[i];
+	else
+	    codes[i] = table[header->n_codes - 1];
+    }
+
+    return codes;
+}
+
+/* get the first code of a weight not below a given weight (or n_codes) */
+unsigned int FindWeightCode(float weight, float *codes, unsigned int n_codes)
+{
+    unsigned int first, last, mid;
+
+    first = 0;
+    last = n_codes;
+
+    while (first < last) {
+	mid = first + (last - first) / 2;
+	if (codes[mid] < weight)
+	    first = mid + 1;
+	else
+	    last = mid;
+    }
+
+    return first;
+}
+
+/* get the code of the weight nearest to a given weight */
+unsigned int EncodeWeight(float weight, float *codes, unsigned int n_codes)
+{
+    unsigned int first;
+
+    first = FindWeightCode(weight, codes, n_codes);
+
+    if (first == n_codes
+	|| (first && weight - codes[first - 1] < codes[first] - weight))
+	first--;
+
+    return first;
+}
+
+/* store a weight as a float or as a quantized code */
+void PutEidxWeight(EIDX_WRITER * writer, unsigned char *pt, float weight)
+{
+    unsigned short code;
+
+    if (writer->weight_width == sizeof(float))
+	memcpy(pt, &weight, sizeof(float));
+    else {
+	code = EncodeWeight(weight, writer->codes,
+			    EIDX_CODES(writer->weight_width));
+	if (writer->weight_width == 1)
+	    *pt = code;
+	else
+	    memcpy(pt, &code, sizeof(unsigned short));
+    }
+}
+
+/* load a quantized code of a weight */
+unsigned int GetEidxCode(unsigned char *pt, unsigned int weight_width)
+{
+    unsigned short code;
+
+    if (weight_width == 1)
+	return *pt;
+
+    memcpy(&code, pt, sizeof(unsigned short));
+    return code;
+}
+
+/* load a weight stored as a float or as a quantized code */
+float GetEidxWeight(unsigned char *pt, unsigned int weight_width,
+		    float *codes)
+{
+    float weight;
+
+    if (weight_width == sizeof(float)) {
+	memcpy(&weight, pt, sizeof(float));
+	return weight;
+    }
+
+    return codes[GetEidxCode(pt, weight_width)];
+}
+
+/* open a writer of edges after the header of an edge index */
+EIDX_WRITER *OpenEidxWriter(FILE * fp, char *file_name,
+			    EIDX_HEADER * header, float *codes)
+{
+    EIDX_WRITER *writer;
+
+    MALLOC(writer, sizeof(EIDX_WRITER));
+    writer->file_name = file_name;
+    writer->fp = fp;
+    writer->id_width = header->id_width;
+    writer->weight_width = header->weight_width;
+    writer->codes = codes;
+    writer->compressed = (header->flags & EIDX_COMPRESSED) != 0;
+    writer->n_buffered = 0;
+    writer->edges = NULL;
+    writer->frame = NULL;
+
+    if (writer->compressed) {
+	MALLOC(writer->edges, sizeof(IDX_EDGE) * EIDX_FRAME);
+	MALLOC(writer->frame, EIDX_FRAME_SZ(EIDX_FRAME));
+    }
+
+    return writer;
+}
+
+/* write edges as records with node IDs of a given width or in frames */
+void WriteEidxEdges(EIDX_WRITER * writer, IDX_EDGE * edges,
+		    unsigned long long n_edges)
+{
+    unsigned long long node;
+    unsigned int node32, record_size;
+    unsigned char buf[EIDX_RECORD_SZ(8, 4) * 1024], *record;
+    size_t i, n;
+
+    /* buffer the edges of a frame */
+    if (writer->compressed) {
+	while (n_edges) {
+	    n = EIDX_FRAME - writer->n_buffered;
+	    if (n > n_edges)
+		n = n_edges;
+
+	    memcpy(writer->edges + writer->n_buffered, edges,
+		   sizeof(IDX_EDGE) * n);
+	    writer->n_buffered += n;
+
+	    if (writer->n_buffered == EIDX_FRAME)
+		WriteEidxFrame(writer);
+
+	    edges += n;
+	    n_edges -= n;
+	}
+	return;
+    }
+
+    /* records of 32-bit IDs & float weights have the layout of IDX_EDGE */
+    if (writer->id_width == sizeof(unsigned int)
+	&& writer->weight_width == sizeof(float)) {
+	if (n_edges && fwrite(edges, sizeof(IDX_EDGE), n_edges,
+			      writer->fp) != n_edges)
+	    OOPS(writer->file_name);
+	return;
+    }
+
+    record_size = EIDX_RECORD_SZ(writer->id_width, writer->weight_width);
+
+    while (n_edges) {
+	n = n_edges < 1024 ? n_edges : 1024;
+
+	for (i = 0, record = buf; i < n; i++, record += record_size) {
+	    if (writer->id_width == 8) {
+		node = edges[i].nodeA;
+		memcpy(record, &node, 8);
+		node = edges[i].nodeB;
+		memcpy(record + 8, &node, 8);
+	    } else {
+		node32 = edges[i].nodeA;
+		memcpy(record, &node32, 4);
+		node32 = edges[i].nodeB;
+		memcpy(record + 4, &node32, 4);
+	    }
+	    PutEidxWeight(writer, record + 2 * writer->id_width,
+			  edges[i].weight);
+	}
+
+	if (fwrite(buf, record_size, n, writer->fp) != n)
+	    OOPS(writer->file_name);
+
+	edges += n;
+	n_edges -= n;
+    }
+}
+
+/* write the buffered edges as a compressed frame */
+void WriteEidxFrame(EIDX_WRITER * writer)
+{
+    unsigned int frame[2];
+
+    if (!writer->n_buffered)
+	return;
+
+    frame[0] = writer->n_buffered;
+    frame[1] = EncodeEidxFrame(writer);
+
+    if (fwrite(frame, sizeof(frame), 1, writer->fp) != 1
+	|| fwrite(writer->frame, 1, frame[1], writer->fp) != frame[1])
+	OOPS(writer->file_name);
+
+    writer->n_buffered = 0;
+}
+
+/* write the last frame & release the writer (the stream stays open) */
+void CloseEidxWriter(EIDX_WRITER * writer)
+{
+    if (writer->compressed)
+	WriteEidxFrame(writer);
+
+    free(writer->edges);
+    free(writer->frame);
+    free(writer);
+}
+
+/* encode edges ordered by node indices, returns the size of the payload */
+unsigned int EncodeEidxFrame(EIDX_WRITER * writer)
+{
+    unsigned int i, n_edges, node_a, node_b, delta;
+    unsigned char *pt, *payload;
+    IDX_EDGE *edges;
+
+    edges = writer->edges;
+    n_edges = writer->n_buffered;
+    payload = writer->frame;
+
+    qsort(edges, n_edges, sizeof(IDX_EDGE), CmpByNodes);
+
+    /* node indices as varints (7 bits per byte, low bits first) */
+    for (i = 0, pt = payload, node_a = 0, node_b = 0; i < n_edges; i++) {
+	delta = edges[i].nodeA - node_a;
+	if (delta)
+	    node_b = 0;
+	node_a = edges[i].nodeA;
+
+	for (; delta >= 0x80; delta >>= 7)
+	    *pt++ = (delta & 0x7f) | 0x80;
+	*pt++ = delta;
+
+	delta = edges[i].nodeB - node_b;
+	node_b = edges[i].nodeB;
+
+	for (; delta >= 0x80; delta >>= 7)
+	    *pt++ = (delta & 0x7f) | 0x80;
+	*pt++ = delta;
+    }
+
+    /* followed by the weights */
+    for (i = 0; i < n_edges; i++, pt += writer->weight_width)
+	PutEidxWeight(writer, pt, edges[i].weight);
+
+    return pt - payload;
+}
+
+/* start a writer thread of a file (of indexed edges if given a writer) */
+FILE_WRITER *OpenFileWriter(FILE * fp, char *file_name, EIDX_WRITER * eidx)
+{
+    unsigned int i;
+    FILE_WRITER *writer;
+
+    MALLOC(writer, sizeof(FILE_WRITER));
+    writer->file_name = file_name;
+    writer->fp = fp;
+    writer->eidx = eidx;
+
+    /* blocks of edges are cut between edges */
+    writer->capacity = WRITE_BLOCK;
+    if (eidx != NULL)
+	writer->capacity -= WRITE_BLOCK % sizeof(IDX_EDGE);
+
+    InitBlockQueue(&writer->full);
+    InitBlockQueue(&writer->empty);
+    for (i = 0; i < WRITE_QUEUE; i++) {
+	if (posix_memalign((void **) &writer->buffers[i].buf, WRITE_ALIGN,
+			   WRITE_BLOCK))
+	    OOPS("Error: posix_memalign()\n");
+	writer->buffers[i].size = 0;
+	PushBlock(&writer->empty, &writer->buffers[i]);
+    }
+    writer->current = (WRITE_BUFFER *) PopBlock(&writer->empty);
+
+    if (pthread_create(&writer->thread, NULL, WriteFileBlocks, writer))
+	OOPS("Error: pthread_create()\n");
+
+    return writer;
+}
+
+/* write the queued blocks until NULL (thread routine) */
+void *WriteFileBlocks(void *pt_arg)
+{
+    FILE_WRITER *writer;
+    WRITE_BUFFER *block;
+
+    writer = (FILE_WRITER *) pt_arg;
+
+    while ((block = (WRITE_BUFFER *) PopBlock(&writer->full)) != NULL) {
+	if (writer->eidx != NULL)
+	    WriteEidxEdges(writer->eidx, (IDX_EDGE *) block->buf,
+			   block->size / sizeof(IDX_EDGE));
+	else if (fwrite(block->buf, 1, block->size, writer->fp) !=
+		 block->size)
+	    OOPS(writer->file_name);
+
+	block->size = 0;
+	PushBlock(&writer->empty, block);
+    }
+
+    return NULL;
+}
+
+/* append bytes to the output of a writer thread */
+void WriteFileBlock(FILE_WRITER * writer, void *data, size_t size)
+{
+    size_t n;
+    WRITE_BUFFER *block;
+
+    block = writer->current;
+
+    /* queue full blocks & continue in an empty one */
+    while (block->size + size > writer->capacity) {
+	n = writer->capacity - block->size;
+	memcpy(block->buf + block->size, data, n);
+	block->size += n;
+	data = (char *) data + n;
+	size -= n;
+
+	PushBlock(&writer->full, block);
+	block = writer->current = (WRITE_BUFFER *) PopBlock(&writer->empty);
+    }
+
+    memcpy(block->buf + block->size, data, size);
+    block->size += size;
+}
+
+/* write the rest of the output & stop a writer thread (the stream stays open) */
+void CloseFileWriter(FILE_WRITER * writer)
+{
+    unsigned int i;
+
+    if (writer->current->size)
+	PushBlock(&writer->full, writer->current);
+    PushBlock(&writer->full, NULL);
+
+    if (pthread_join(writer->thread, NULL))
+	OOPS("Error: pthread_join()\n");
+
+    for (i = 0; i < WRITE_QUEUE; i++)
+	free(writer->buffers[i].buf);
+    FreeBlockQueue(&writer->full);
+    FreeBlockQueue(&writer->empty);
+    free(writer);
+}
+
+/*
+ * Decode a frame of edges & keep those whose codes pass the cutoff of the
+ * reader, returns non-zero if the payload is corrupted.
+ */
+unsigned int DecodeEidxFrame(EIDX_READER * reader, unsigned char *payload,
+			     unsigned int size, IDX_EDGE * edges,
+			     unsigned int n_edges, unsigned int *n_kept)
+{
+    unsigned long long node_a, node_b, delta;
+    unsigned int i, j, k, code, shift, weight_width;
+    unsigned char *pt, *end;
+
+    weight_width = reader->weight_width;
+    if (size < n_edges * weight_width)
+	return 1;
+
+    pt = payload;
+    end = payload + size - n_edges * weight_width;
+    node_a = 0;
+    node_b = 0;
+
+    for (i = 0; i < n_edges; i++) {
+	for (j = 0; j < 2; j++) {
+	    for (delta = 0, shift = 0; pt < end && (*pt & 0x80);
+		 shift += 7)
+		delta |= (unsigned long long) (*pt++ & 0x7f) << shift;
+	    if (pt == end || shift > 28)
+		return 1;
+	    delta |= (unsigned long long) *pt++ << shift;
+
+	    if (j == 0) {
+		if (delta)
+		    node_b = 0;
+		node_a += delta;
+	    } else
+		node_b += delta;
+	}
+
+	if (node_a > UINT_MAX || node_b > UINT_MAX)
+	    return 1;
+
+	edges[i].nodeA = node_a;
+	edges[i].nodeB = node_b;
+    }
+
+    if (pt != end)
+	return 1;
+
+    for (i = 0, k = 0; i < n_edges; i++, pt += weight_width) {
+	if (weight_width == sizeof(float)) {
+	    memcpy(&edges[i].weight, pt, sizeof(float));
+	    continue;
+	}
+
+	/* compare the raw codes, only the edges passing are moved & decoded */
+	code = GetEidxCode(pt, weight_width);
+	if (code < reader->code_min || code > reader->code_max)
+	    continue;
+
+	edges[k].nodeA = edges[i].nodeA;
+	edges[k].nodeB = edges[i].nodeB;
+	edges[k++].weight = reader->codes[code];
+    }
+
+    *n_kept = weight_width == sizeof(float) ? n_edges : k;
+    return 0;
+}
+
+/* open an edge index for reading (version 1 or 2) */
+EIDX_READER *OpenEidxReader(char *file_name)
+{
+    unsigned long long offset;
+    unsigned int n_edges;
+    char pending[sizeof(unsigned int)];
+    float *table;
+    struct stat st;
+    EIDX_HEADER *header;
+    EIDX_READER *reader;
+
+    MALLOC(reader, sizeof(EIDX_READER));
+    FOPEN(reader->fp, file_name, "rb");
+    reader->file_name = file_name;
+    reader->map = NULL;
+    reader->map_size = 0;
+    reader->records = NULL;
+    reader->edges = NULL;
+    reader->marks = NULL;
+    reader->n_read = 0;
+    reader->bytes_mapped = 0;
+    reader->codes = NULL;
+    reader->code_min = 0;
+    reader->code_max = UINT_MAX;
+    header = &reader->header;
+
+    /*
+     * read the file header (version 1 starts with the number of edges, so
+     * the first edge may be read with the magic number)
+     */
+    reader->n_pending = 0;
+    if (fread(header, sizeof(unsigned int), 1, reader->fp) == 0)
+	OOPS(file_name);
+    if (!memcmp(header->magic, EIDX_MAGIC, sizeof(unsigned int))
+	&& fread(header->magic + sizeof(unsigned int), sizeof(unsigned int),
+		 1, reader->fp))
+	reader->n_pending = sizeof(unsigned int);
+
+    if (memcmp(header->magic, EIDX_MAGIC, INDEX_MAGIC_SZ)) {
+	memcpy(&n_edges, header, sizeof(unsigned int));
+	memcpy(pending, header->magic + sizeof(unsigned int),
+	       sizeof(unsigned int));
+	InitEidxHeader(header, sizeof(unsigned int), 0, 0);
+	header->version = 1;
+	header->n_edges = n_edges;
+	header->data_offset = sizeof(unsigned int);
+    } else {
+	reader->n_pending = 0;
+	if (fread(header->magic + INDEX_MAGIC_SZ,
+		  sizeof(EIDX_HEADER) - INDEX_MAGIC_SZ, 1, reader->fp) == 0
+	    || (header->id_width != 4 && header->id_width != 8)
+	    || (header->weight_width != 1 && header->weight_width != 2
+		&& header->weight_width != 4)
+	    || header->n_marks > EIDX_MARKS
+	    || (header->weight_width == sizeof(float) && header->n_codes)
+	    || (header->weight_width < sizeof(float)
+		&& header->n_codes > EIDX_CODES(header->weight_width))
+	    || header->data_offset <
+	    sizeof(EIDX_HEADER) + header->n_marks * sizeof(EIDX_MARK) +
+	    header->n_codes * sizeof(float))
+	    ExitIndexError(file_name, "is not an edge index.");
+	CheckIndexVersion(file_name, header->version, header->byte_order);
+
+	/* read the weight marks (kept for sorted edges only) */
+	if (header->n_marks) {
+	    MALLOC(reader->marks, sizeof(EIDX_MARK) * header->n_marks);
+	    if (fread(reader->marks, sizeof(EIDX_MARK), header->n_marks,
+		      reader->fp) != header->n_marks)
+		OOPS(file_name);
+	    if (!(header->flags & EIDX_SORTED)) {
+		free(reader->marks);
+		reader->marks = NULL;
+	    }
+	}
+
+	/* read the code table & get the weights of quantized codes */
+	if (header->weight_width < sizeof(float)) {
+	    MALLOC(table, sizeof(float) * (header->n_codes + 1));
+	    if (fread(table, sizeof(float), header->n_codes,
+		      reader->fp) != header->n_codes)
+		OOPS(file_name);
+	    reader->codes = BuildWeightCodes(header, table);
+	    free(table);
+	}
+
+	/* skip the header extensions of later versions */
+	for (offset = sizeof(EIDX_HEADER) +
+	     header->n_marks * sizeof(EIDX_MARK) +
+	     header->n_codes * sizeof(float);
+	     offset < header->data_offset; offset++)
+	    if (getc(reader->fp) == EOF)
+		OOPS(file_name);
+    }
+
+    reader->n_edges = header->n_edges;
+    reader->n_left = header->n_edges;
+    reader->weight_width = header->weight_width;
+    reader->record_size =
+	EIDX_RECORD_SZ(header->id_width, header->weight_width);
+    reader->compressed = (header->flags & EIDX_COMPRESSED) != 0;
+    reader->decode = reader->compressed
+	|| header->id_width != sizeof(unsigned int)
+	|| header->weight_width != sizeof(float);
+
+    /* map regular files into memory */
+    if (fstat(fileno(reader->fp), &st) == 0 && S_ISREG(st.st_mode)) {
+	if ((unsigned long long) st.st_size < header->data_offset ||
+	    (!reader->compressed &&
+	     ((unsigned long long) st.st_size - header->data_offset) /
+	     reader->record_size < reader->n_edges))
+	    ExitIndexError(file_name, "is truncated.");
+
+	reader->map_size = st.st_size;
+	reader->map = mmap(NULL, reader->map_size, PROT_READ, MAP_PRIVATE,
+			   fileno(reader->fp), 0);
+
+	if (reader->map == MAP_FAILED)
+	    reader->map = NULL;
+	else {
+	    madvise(reader->map, reader->map_size, MADV_SEQUENTIAL);
+	    reader->records = (char *) reader->map + header->data_offset;
+	    if (!reader->decode)
+		reader->edges = (IDX_EDGE *) reader->records;
+	}
+    }
+
+    /* fall back to block reads */
+    if (reader->map == NULL && reader->compressed)
+	MALLOC(reader->records, EIDX_FRAME_SZ(EIDX_FRAME));
+    if (reader->map == NULL && !reader->compressed) {
+	MALLOC(reader->records, (size_t) reader->record_size * EIDX_BLOCK);
+	if (!reader->decode)
+	    reader->edges = (IDX_EDGE *) reader->records;
+	memcpy(reader->records, pending, reader->n_pending);
+    }
+
+    /* convert records of a different layout block by block */
+    if (reader->decode)
+	MALLOC(reader->edges, sizeof(IDX_EDGE) * EIDX_BLOCK);
+
+    return reader;
+}
+
+/*
+ * Convert edge records with 64-bit node IDs or quantized weights, returns the
+ * number of edges whose codes pass the cutoff of the reader.
+ */
+unsigned long long DecodeEidxRecords(EIDX_READER * reader, IDX_EDGE * edges,
+				     unsigned long long n_edges)
+{
+    unsigned long long i, k, node_a, node_b;
+    unsigned int id_width, weight_width, node32, code;
+    unsigned char *weight;
+    char *record;
+
+    id_width = reader->header.id_width;
+    weight_width = reader->weight_width;
+
+    for (i = 0, k = 0, record = reader->records; i < n_edges;
+	 i++, record += reader->record_size) {
+	weight = (unsigned char *) record + 2 * id_width;
+
+	/* compare the raw codes, only the edges passing are decoded */
+	if (weight_width != sizeof(float)) {
+	    code = GetEidxCode(weight, weight_width);
+	    if (code < reader->code_min || code > reader->code_max)
+		continue;
+	}
+
+	if (id_width == 8) {
+	    memcpy(&node_a, record, 8);
+	    memcpy(&node_b, record + 8, 8);
+
+	    if (node_a > UINT_MAX || node_b > UINT_MAX)
+		ExitIndexError(reader->file_name, "has too many nodes.");
+	} else {
+	    memcpy(&node32, record, 4);
+	    node_a = node32;
+	    memcpy(&node32, record + 4, 4);
+	    node_b = node32;
+	}
+
+	edges[k].nodeA = node_a;
+	edges[k].nodeB = node_b;
+	edges[k++].weight = GetEidxWeight(weight, weight_width, reader->codes);
+    }
+
+    return k;
+}
+
+/* keep only the edges whose quantized weights pass a cutoff */
+void FilterEidxCodes(EIDX_READER * reader, unsigned int weight_type,
+		     float weight_cutoff)
+{
+    unsigned int first, n_codes;
+
+    /*
+     * The codes are in the order of their weights, so the codes passing the
+     * cutoff are a range found once (the edges kept are those whose decoded
+     * weights pass the cutoff).
+     */
+    n_codes = EIDX_CODES(reader->weight_width);
+    first = FindWeightCode(weight_cutoff, reader->codes, n_codes);
+
+    if (!weight_type) {
+	reader->code_min = first;
+	reader->code_max = n_codes - 1;
+    } else {
+	while (first < n_codes && reader->codes[first] == weight_cutoff)
+	    first++;
+	reader->code_min = first ? 0 : 1;
+	reader->code_max = first ? first - 1 : 0;
+    }
+}
+
+/*
+ * Stop reading a sorted index at the first mark failing a cutoff & filter
+ * the quantized weights by their codes.
+ */
+void LimitEidxReader(EIDX_READER * reader, unsigned int weight_type,
+		     float weight_cutoff)
+{
+    unsigned long long first, last, mid;
+    float weight;
+
+    if (reader->codes != NULL)
+	FilterEidxCodes(reader, weight_type, weight_cutoff);
+
+    if (reader->marks == NULL || reader->header.weight_type != weight_type
+	|| reader->n_left != reader->n_edges)
+	return;
+
+    /* binary search of the first mark failing the cutoff */
+    first = 0;
+    last = reader->header.n_marks;
+
+    while (first < last) {
+	mid = first + (last - first) / 2;
+	weight = reader->marks[mid].weight;
+
+	if ((weight_type && weight > weight_cutoff)
+	    || (!weight_type && weight < weight_cutoff))
+	    last = mid;
+	else
+	    first = mid + 1;
+    }
+
+    /* edges from the failing mark on fail too, the others are filtered */
+    if (first < reader->header.n_marks)
+	reader->n_left = reader->marks[first].edge;
+}
+
+/* get the next block of edges, returns zero at the end of the index */
+unsigned long long ReadEidxBlock(EIDX_READER * reader, IDX_EDGE ** edges)
+{
+    unsigned long long n, n_kept;
+
+    /* a mapping of IDX_EDGE records is a single block of all edges */
+    if (reader->map != NULL && !reader->decode) {
+	n = reader->n_left;
+	reader->n_left = 0;
+	reader->n_read += n;
+	reader->bytes_mapped += n * reader->record_size;
+	*edges = reader->edges;
+	return n;
+    }
+
+    if (reader->compressed)
+	return ReadEidxFrames(reader, edges);
+
+    /* blocks without any edge passing the codes of the cutoff are skipped */
+    do {
+	n = reader->n_left < EIDX_BLOCK ? reader->n_left : EIDX_BLOCK;
+
+	if (reader->map == NULL && n) {
+	    if (fread(reader->records + reader->n_pending, 1,
+		      n * reader->record_size - reader->n_pending,
+		      reader->fp) !=
+		n * reader->record_size - reader->n_pending)
+		OOPS(reader->file_name);
+	    reader->n_pending = 0;
+	}
+
+	n_kept = reader->decode ?
+	    DecodeEidxRecords(reader, reader->edges, n) : n;
+
+	if (reader->map != NULL) {
+	    reader->records += n * reader->record_size;
+	    reader->bytes_mapped += n * reader->record_size;
+	}
+
+	reader->n_left -= n;
+	reader->n_read += n;
+    } while (n && !n_kept);
+
+    *edges = reader->edges;
+    return n_kept;
+}
+
+/* decode the next frames of a compressed index into a block of edges */
+unsigned long long ReadEidxFrames(EIDX_READER * reader, IDX_EDGE ** edges)
+{
+    unsigned long long n;
+    unsigned int frame[2], n_kept;
+    char *payload, *end;
+
+    n = 0;
+    end = (char *) reader->map + reader->map_size;
+
+    while (reader->n_left && n + EIDX_FRAME <= EIDX_BLOCK) {
+	/* read the number of edges & size of the payload */
+	if (reader->map != NULL) {
+	    if (end - reader->records < (long) sizeof(frame))
+		ExitIndexError(reader->file_name, "is truncated.");
+	    memcpy(frame, reader->records, sizeof(frame));
+	    payload = reader->records + sizeof(frame);
+
+	    if (frame[1] > EIDX_FRAME_SZ(EIDX_FRAME)
+		|| end - payload < (long) frame[1])
+		ExitIndexError(reader->file_name, "is truncated.");
+	    reader->records = payload + frame[1];
+	    reader->bytes_mapped += sizeof(frame) + frame[1];
+	} else {
+	    if (fread(frame, sizeof(frame), 1, reader->fp) != 1
+		|| frame[1] > EIDX_FRAME_SZ(EIDX_FRAME)
+		|| fread(reader->records, 1, frame[1],
+			 reader->fp) != frame[1])
+		ExitIndexError(reader->file_name, "is truncated.");
+	    payload = reader->records;
+	}
+
+	if (frame[0] > EIDX_FRAME
+	    || DecodeEidxFrame(reader, (unsigned char *) payload, frame[1],
+			       reader->edges + n, frame[0], &n_kept))
+	    ExitIndexError(reader->file_name, "is corrupted.");
+
+	n += n_kept;
+	reader->n_read += frame[0];
+	reader->n_left -= frame[0] < reader->n_left ? frame[0] : reader->n_left;
+    }
+
+    *edges = reader->edges;
+    return n;
+}
+
+/* skip the first edges of an index, returns 1 unless at a frame boundary */
+unsigned int SkipEidxEdges(EIDX_READER * reader, unsigned long long n_edges)
+{
+    unsigned long long n;
+    unsigned int frame[2];
+    char *end;
+
+    if (n_edges > reader->n_left)
+	return 1;
+
+    /* skip whole records */
+    if (!reader->compressed) {
+	if (reader->map != NULL) {
+	    reader->records += n_edges * reader->record_size;
+	    if (!reader->decode)
+		reader->edges += n_edges;
+	} else if (n_edges) {
+	    if (fseeko(reader->fp, n_edges * reader->record_size -
+		       reader->n_pending, SEEK_CUR))
+		OOPS(reader->file_name);
+	    reader->n_pending = 0;
+	}
+
+	reader->n_left -= n_edges;
+	return 0;
+    }
+
+    /* skip whole frames without decoding them */
+    end = (char *) reader->map + reader->map_size;
+
+    for (n = 0; n < n_edges; n += frame[0]) {
+	if (reader->map != NULL) {
+	    if (end - reader->records < (long) sizeof(frame))
+		ExitIndexError(reader->file_name, "is truncated.");
+	    memcpy(frame, reader->records, sizeof(frame));
+	    if (end - reader->records - (long) sizeof(frame) <
+		(long) frame[1])
+		ExitIndexError(reader->file_name, "is truncated.");
+	    reader->records += sizeof(frame) + frame[1];
+	} else if (fread(frame, sizeof(frame), 1, reader->fp) != 1
+		   || fseeko(reader->fp, frame[1], SEEK_CUR))
+	    ExitIndexError(reader->file_name, "is truncated.");
+
+	if (frame[0] == 0 || frame[0] > EIDX_FRAME)
+	    ExitIndexError(reader->file_name, "is corrupted.");
+    }
+
+    reader->n_left -= n_edges;
+    return n != n_edges;
+}
+
+/* get the FNV-1a hash of the end of an edge index of a given size */
+unsigned long long HashEidxTail(EIDX_READER * reader,
+				unsigned long long size)
+{
+    unsigned long long hash, offset;
+    unsigned char buffer[UFS_TAIL];
+    ssize_t i, n;
+
+    /* the header changes when edges are appended, the edges do not */
+    offset = reader->header.data_offset;
+    if (size > offset + UFS_TAIL)
+	offset = size - UFS_TAIL;
+
+    n = size > offset ? size - offset : 0;
+    if (n && pread(fileno(reader->fp), buffer, n, offset) != n)
+	OOPS(reader->file_name);
+
+    for (i = 0, hash = 14695981039346656037ULL; i < n; i++) {
+	hash ^= buffer[i];
+	hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+/* close an edge index */
+void CloseEidxReader(EIDX_READER * reader)
+{
+    if (reader->map != NULL)
+	munmap(reader->map, reader->map_size);
+    else
+	free(reader->records);
+
+    if (reader->decode)
+	free(reader->edges);
+
+    free(reader->marks);
+    free(reader->codes);
+    FCLOSE(reader->fp, reader->file_name);
+    free(reader);
+}
+
+/* load a node index into the lookup table (a single mapping or read) */
+void OpenNidxTable(NIDX_TABLE * table, char *file_name)
+{
+    unsigned long long blob_size, size;
+    size_t n, max_size;
+    struct stat st;
+    NIDX_HEADER header;
+    FILE *fp;
+
+    FOPEN(fp, file_name, "rb");
+    table->mapped = 0;
+
+    /* map regular files into memory, read other files at once */
+    if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)) {
+	table->data_size = st.st_size;
+	table->data = mmap(NULL, table->data_size, PROT_READ, MAP_PRIVATE,
+			   fileno(fp), 0);
+	if (table->data != MAP_FAILED)
+	    table->mapped = 1;
+    }
+
+    if (!table->mapped) {
+	max_size = 1 << 20;
+	table->data_size = 0;
+	MALLOC(table->data, max_size);
+
+	while ((n = fread((char *) table->data + table->data_size, 1,
+			  max_size - table->data_size, fp)) != 0) {
+	    table->data_size += n;
+	    if (table->data_size == max_size) {
+		max_size *= 2;
+		if ((table->data = realloc(table->data, max_size)) == NULL)
+		    OOPS("Error: realloc()\n");
+	    }
+	}
+	if (ferror(fp))
+	    OOPS(file_name);
+    }
+    FCLOSE(fp, file_name);
+
+    /* read the versioned file header */
+    if (table->data_size >= sizeof(NIDX_HEADER)
+	&& !memcmp(table->data, NIDX_MAGIC, INDEX_MAGIC_SZ)) {
+	memcpy(&header, table->data, sizeof(NIDX_HEADER));
+	CheckIndexVersion(file_name, header.version, header.byte_order);
+
+	if (header.n_nodes > UINT_MAX)
+	    ExitIndexError(file_name, "has too many nodes.");
+
+	table->table_size = header.n_nodes;
+	table->node_buffer_size = NIDX_VARLEN;
+	table->labels = (char *) table->data + sizeof(NIDX_HEADER);
+	blob_size = (header.blob_size + 7) & ~7ULL;
+	table->offsets =
+	    (unsigned long long *) (table->labels + blob_size);
+	size = sizeof(NIDX_HEADER) + blob_size +
+	    header.n_nodes * sizeof(unsigned long long);
+
+	if (table->data_size < size)
+	    ExitIndexError(file_name, "is truncated.");
+	return;
+    }
+
+    /* read the unversioned file header */
+    if (table->data_size < 2 * sizeof(unsigned int))
+	ExitIndexError(file_name, "is truncated.");
+    memcpy(&table->table_size, table->data, sizeof(unsigned int));
+    memcpy(&table->node_buffer_size,
+	   (char *) table->data + sizeof(unsigned int),
+	   sizeof(unsigned int));
+
+    /* point the lookup table into the contents (labels of a fixed size) */
+    if (table->node_buffer_size == 0)
+	ExitIndexError(file_name, "is not a node index.");
+    table->labels = (char *) table->data + 2 * sizeof(unsigned int);
+    table->offsets = NULL;
+    size = 2 * sizeof(unsigned int) +
+	(unsigned long long) table->table_size * table->node_buffer_size;
+
+    if (table->data_size < size)
+	ExitIndexError(file_name, "is truncated.");
+}
+
+/* release a node lookup table */
+void CloseNidxTable(NIDX_TABLE * table)
+{
+    if (table->mapped)
+	munmap(table->data, table->data_size);
+    else
+	free(table->data);
+}
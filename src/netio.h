@@ -0,0 +1,243 @@
+/*
+ * File:	netio.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETIO_H
+#define	NETIO_H
+
+#define EIDX_BLOCK 1048576	/* edges read at once if the index cannot be mapped */
+#define NIDX_VARLEN 0		/* node buffer size of variable-length labels */
+#define EIDX_MAGIC "NETCEIDX"	/* magic number of the edge index */
+#define NIDX_MAGIC "NETCNIDX"	/* magic number of the node index */
+#define INDEX_MAGIC_SZ 8	/* size of the magic numbers */
+#define INDEX_VERSION 2		/* version of the index format */
+#define BYTE_ORDER_MARK 0x01020304	/* byte order of the indexing host */
+#define EIDX_SORTED 1		/* flag: edges sorted by weight (best first) */
+#define EIDX_COMPRESSED 2	/* flag: edges in delta/varint encoded frames */
+#define EIDX_FRAME 65536	/* maximum number of edges per compressed frame */
+#define EIDX_MARKS 1024		/* maximum number of weight marks of sorted edges */
+#define UFS_MAGIC "NETCUFSS"	/* magic number of the union-find snapshot */
+#define UFS_TAIL 4096		/* bytes at the end of the edge index hashed by a snapshot */
+#define WRITE_BLOCK 4194304	/* bytes per block of a writer thread */
+#define WRITE_QUEUE 4		/* blocks of a writer thread */
+#define WRITE_ALIGN 4096	/* alignment of the blocks of a writer thread */
+
+/* get the size of an edge record with node IDs & a weight of given widths */
+#define EIDX_RECORD_SZ(w, v) (2 * (w) + (v))
+
+/* get the number of codes of quantized weights of a given width */
+#define EIDX_CODES(v) (1U << (8 * (v)))
+
+/* get the maximum size of a compressed frame (varint IDs & float weights) */
+#define EIDX_FRAME_SZ(n) (2 * sizeof(unsigned int) + (n) * (10 + sizeof(float)))
+
+/* get the label of a node from the lookup table */
+#define NODE_LABEL(t, i) ((t)->offsets != NULL ? \
+	(t)->labels + (t)->offsets[i] : \
+	(t)->labels + (size_t) (i) * (t)->node_buffer_size)
+
+/* typedefs */
+typedef struct _eidx_header_ EIDX_HEADER;	/* header of the edge index */
+typedef struct _nidx_header_ NIDX_HEADER;	/* header of the node index */
+typedef struct _eidx_mark_ EIDX_MARK;	/* weight of a sorted edge */
+typedef struct _eidx_reader_ EIDX_READER;	/* reader of indexed edges */
+typedef struct _eidx_writer_ EIDX_WRITER;	/* writer of indexed edges */
+typedef struct _write_buffer_ WRITE_BUFFER;	/* block of output */
+typedef struct _file_writer_ FILE_WRITER;	/* writer thread of a file */
+typedef struct _nidx_table_ NIDX_TABLE;	/* lookup table of node aliases */
+typedef struct _ufs_header_ UFS_HEADER;	/* header of the union-find snapshot */
+
+/* type declarations */
+struct _eidx_header_ {
+    char magic[INDEX_MAGIC_SZ];	/* EIDX_MAGIC */
+    unsigned int version;	/* format version */
+    unsigned int byte_order;	/* BYTE_ORDER_MARK of the writing host */
+    unsigned int id_width;	/* bytes per node ID (4 or 8) */
+    unsigned int flags;		/* layout flags (EIDX_SORTED, EIDX_COMPRESSED) */
+    unsigned long long n_edges;	/* number of edges */
+    unsigned long long data_offset;	/* file offset of the first edge */
+    unsigned int weight_type;	/* weight type used for indexing */
+    float weight_cutoff;	/* weight cutoff used for indexing */
+    unsigned long long n_marks;	/* number of weight marks after the header */
+    unsigned int weight_width;	/* bytes per weight (4 for floats, 1 or 2 for codes) */
+    unsigned int n_codes;	/* number of weights in the code table (0 if linear) */
+    float weight_scale;		/* linear codes: weight = offset + code * scale */
+    float weight_offset;	/* weight of the code zero of linear codes */
+    unsigned long long reserved[3];	/* zero, reserved for extensions */
+};
+
+/*
+ * The edges of a sorted index are sampled at regular steps, so that the edges
+ * passing a cutoff are found by a binary search of the marks.
+ */
+struct _eidx_mark_ {
+    float weight;		/* weight of the marked edge */
+    unsigned int reserved;	/* zero */
+    unsigned long long edge;	/* position of the marked edge */
+};
+
+struct _nidx_header_ {
+    char magic[INDEX_MAGIC_SZ];	/* NIDX_MAGIC */
+    unsigned int version;	/* format version */
+    unsigned int byte_order;	/* BYTE_ORDER_MARK of the writing host */
+    unsigned long long n_nodes;	/* number of nodes */
+    unsigned long long blob_size;	/* size of the node labels */
+    unsigned long long reserved[2];	/* zero, reserved for extensions */
+};
+
+struct _eidx_reader_ {
+    char *file_name;		/* edge index file */
+    FILE *fp;			/* edge index stream */
+    EIDX_HEADER header;		/* file header (version 1 is converted) */
+    unsigned long long n_edges;	/* number of edges in the index */
+    unsigned long long n_left;	/* number of edges not read yet */
+    unsigned int record_size;	/* size of an edge record in the file */
+    unsigned int weight_width;	/* bytes per weight in the file */
+    float *codes;		/* weights of quantized codes (or NULL) */
+    unsigned int code_min;	/* first code passing the cutoff */
+    unsigned int code_max;	/* last code passing the cutoff */
+    unsigned int decode;	/* 1 if records differ from IDX_EDGE */
+    unsigned int compressed;	/* 1 if edges are in compressed frames */
+    EIDX_MARK *marks;		/* weight marks of sorted edges (or NULL) */
+    void *map;			/* memory mapping of the index (or NULL) */
+    size_t map_size;		/* size of the mapping */
+    char *records;		/* next mapped record or read buffer */
+    IDX_EDGE *edges;		/* mapped edges or decoded buffer */
+    unsigned long long n_read;	/* number of edges read */
+    unsigned long long bytes_mapped;	/* bytes of edges read from the mapping */
+    unsigned int n_pending;	/* bytes of the first record read with the header */
+};
+
+/*
+ * A compressed index is a sequence of frames of at most EIDX_FRAME edges:
+ *
+ *   [number of edges (4 bytes)] [size of the payload (4 bytes)] [payload]
+ *
+ * where the payload holds the edges ordered by node indices as varints of the
+ * increment of node A (0 for the same node A) & of node B (from the previous
+ * node B of the same node A, otherwise from 0), followed by all the weights.
+ * Frames decode independently of each other.
+ */
+struct _eidx_writer_ {
+    char *file_name;		/* edge index file */
+    FILE *fp;			/* edge index stream */
+    unsigned int id_width;	/* bytes per node ID of uncompressed records */
+    unsigned int weight_width;	/* bytes per weight */
+    float *codes;		/* weights of quantized codes (or NULL) */
+    unsigned int compressed;	/* 1 if edges are written in frames */
+    unsigned int n_buffered;	/* number of edges of the current frame */
+    IDX_EDGE *edges;		/* edges of the current frame */
+    unsigned char *frame;	/* encoded frame */
+};
+
+struct _write_buffer_ {
+    char *buf;			/* output bytes */
+    size_t size;		/* bytes in the buffer */
+};
+
+/*
+ * A writer thread writes the blocks of output of a file in the order they are
+ * filled; the blocks of an edge index hold whole edges (IDX_EDGE), which go
+ * to an EIDX_WRITER. The filling thread waits while all blocks are queued.
+ */
+struct _file_writer_ {
+    char *file_name;		/* output file */
+    FILE *fp;			/* output stream */
+    EIDX_WRITER *eidx;		/* writer of indexed edges (or NULL for bytes) */
+    size_t capacity;		/* bytes per block */
+    WRITE_BUFFER buffers[WRITE_QUEUE];	/* blocks of the writer */
+    WRITE_BUFFER *current;	/* block being filled */
+    BLOCK_QUEUE full;		/* blocks to write */
+    BLOCK_QUEUE empty;		/* blocks free for filling */
+    pthread_t thread;		/* writer thread */
+};
+
+struct _nidx_table_ {
+    unsigned int table_size;	/* size of the lookup table */
+    unsigned int node_buffer_size;	/* size of fixed-length labels */
+    char *labels;		/* node labels stored back to back */
+    unsigned long long *offsets;	/* offsets of variable-length labels */
+    void *data;			/* contents of the node index file */
+    size_t data_size;		/* size of the contents */
+    unsigned int mapped;	/* 1 if the contents are memory-mapped */
+};
+
+/*
+ * A union-find snapshot holds the union sets of the nodes after merging the
+ * first n_edges edges of an edge index. Appending to the index leaves those
+ * edges & the end of the index as they were, so a later run merges only the
+ * edges after them.
+ */
+struct _ufs_header_ {
+    char magic[INDEX_MAGIC_SZ];	/* UFS_MAGIC */
+    unsigned int version;	/* format version */
+    unsigned int byte_order;	/* BYTE_ORDER_MARK of the writing host */
+    unsigned int weight_type;	/* weight type of the merged edges */
+    float weight_cutoff;	/* weight cutoff of the merged edges */
+    unsigned long long n_nodes;	/* number of union sets after the header */
+    unsigned long long n_edges;	/* number of edges of the index read */
+    unsigned long long n_edges_passed;	/* number of edges merged */
+    unsigned long long eidx_size;	/* size of the edge index */
+    unsigned long long eidx_hash;	/* hash of the end of the edge index */
+    unsigned long long reserved[2];	/* zero, reserved for extensions */
+};
+
+/* function prototypes */
+extern void InitEidxHeader(EIDX_HEADER *, unsigned int, unsigned int,
+			   float);
+extern void InitNidxHeader(NIDX_HEADER *);
+extern void CheckIndexVersion(char *, unsigned int, unsigned int);
+extern void ExitIndexError(char *, char *);
+extern float *BuildWeightCodes(EIDX_HEADER *, float *);
+extern unsigned int FindWeightCode(float, float *, unsigned int);
+extern unsigned int EncodeWeight(float, float *, unsigned int);
+extern EIDX_WRITER *OpenEidxWriter(FILE *, char *, EIDX_HEADER *, float *);
+extern void PutEidxWeight(EIDX_WRITER *, unsigned char *, float);
+extern unsigned int GetEidxCode(unsigned char *, unsigned int);
+extern float GetEidxWeight(unsigned char *, unsigned int, float *);
+extern void WriteEidxEdges(EIDX_WRITER *, IDX_EDGE *, unsigned long long);
+extern void WriteEidxFrame(EIDX_WRITER *);
+extern void CloseEidxWriter(EIDX_WRITER *);
+extern unsigned int EncodeEidxFrame(EIDX_WRITER *);
+extern FILE_WRITER *OpenFileWriter(FILE *, char *, EIDX_WRITER *);
+extern void *WriteFileBlocks(void *);
+extern void WriteFileBlock(FILE_WRITER *, void *, size_t);
+extern void CloseFileWriter(FILE_WRITER *);
+extern unsigned int DecodeEidxFrame(EIDX_READER *, unsigned char *,
+				    unsigned int, IDX_EDGE *, unsigned int,
+				    unsigned int *);
+extern EIDX_READER *OpenEidxReader(char *);
+extern unsigned long long DecodeEidxRecords(EIDX_READER *, IDX_EDGE *,
+					    unsigned long long);
+extern void FilterEidxCodes(EIDX_READER *, unsigned int, float);
+extern void LimitEidxReader(EIDX_READER *, unsigned int, float);
+extern unsigned long long ReadEidxBlock(EIDX_READER *, IDX_EDGE **);
+extern unsigned long long ReadEidxFrames(EIDX_READER *, IDX_EDGE **);
+extern unsigned int SkipEidxEdges(EIDX_READER *, unsigned long long);
+extern unsigned long long HashEidxTail(EIDX_READER *, unsigned long long);
+extern void CloseEidxReader(EIDX_READER *);
+extern void OpenNidxTable(NIDX_TABLE *, char *);
+extern void CloseNidxTable(NIDX_TABLE *);
+
+#endif				/* NETIO_H */
@@ -0,0 +1,367 @@
+/*
+ * File:	netlib.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Library interface (libnetclust.a) for graphs held in memory.
+ *
+ * A program builds a node dictionary & adds batches of edges from arrays,
+ * then gets the single-linkage clusters at a cutoff as a PARTITION:
+ *
+ *   NCL_GRAPH *graph;
+ *   PARTITION *par;
+ *
+ *   NclNewGraph(&graph, 0);
+ *   NclAddLabeledEdges(graph, labels_a, labels_b, weights, n);
+ *   NclClusterGraph(graph, 500, 1, &par, NULL);
+ *
+ *   for (i = 0; i < NclNumClusters(par); i++)
+ *       members = NclClusterMembers(par, i, &size);
+ *
+ * Clusters are ordered by size like the output of netclust. The calls return
+ * a status code (NCL_OK on success) instead of exiting the process.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "netlib.h"
+
+/* create an empty graph of a weight type (0 - similarity, 1 - distance) */
+int NclNewGraph(NCL_GRAPH ** graph, unsigned int weight_type)
+{
+    NCL_GRAPH *g;
+
+    *graph = NULL;
+
+    if (weight_type > 1)
+	return NCL_BAD_ARGUMENT;
+
+    if ((g = malloc(sizeof(NCL_GRAPH))) == NULL)
+	return NCL_NO_MEMORY;
+
+    g->weight_type = weight_type;
+    g->n_edges = 0;
+    g->max_edges = NCL_EDGES;
+    g->dict = AllocHashTable(HASH_TABLE_SZ);
+    g->edges = malloc(sizeof(IDX_EDGE) * g->max_edges);
+
+    if (g->dict == NULL || g->edges == NULL) {
+	NclFreeGraph(g);
+	return NCL_NO_MEMORY;
+    }
+
+    *graph = g;
+    return NCL_OK;
+}
+
+/* release memory of a graph (partitions of the graph stay valid) */
+void NclFreeGraph(NCL_GRAPH * graph)
+{
+    if (graph == NULL)
+	return;
+
+    if (graph->dict != NULL)
+	FreeHashTable(graph->dict);
+    free(graph->edges);
+    free(graph);
+}
+
+/* get the index of a node label, adding the label if it is new */
+int NclAddNode(NCL_GRAPH * graph, const char *label, unsigned int *node)
+{
+    unsigned int is_new;
+
+    if (InsertHashKey(graph->dict, (char *) label, node, &is_new))
+	return NCL_NO_MEMORY;
+
+    return NCL_OK;
+}
+
+/* get the index of a known node label */
+int NclFindNode(NCL_GRAPH * graph, const char *label, unsigned int *node)
+{
+    if (!GetHashValue(graph->dict, (char *) label, node))
+	return NCL_BAD_NODE;
+
+    return NCL_OK;
+}
+
+/* get the label of a node index (or NULL) */
+const char *NclNodeLabel(NCL_GRAPH * graph, unsigned int node)
+{
+    if (node >= graph->dict->n_keys)
+	return NULL;
+
+    return GetHashKey(graph->dict, node);
+}
+
+/* get the number of nodes of a graph */
+unsigned int NclNumNodes(NCL_GRAPH * graph)
+{
+    return graph->dict->n_keys;
+}
+
+/* get the number of edges of a graph */
+unsigned long long NclNumEdges(NCL_GRAPH * graph)
+{
+    return graph->n_edges;
+}
+
+/* make room for a number of edges more */
+int NclReserveEdges(NCL_GRAPH * graph, unsigned long long n_edges)
+{
+    unsigned long long max_edges;
+    IDX_EDGE *edges;
+
+    if (graph->n_edges + n_edges <= graph->max_edges)
+	return NCL_OK;
+
+    for (max_edges = graph->max_edges;
+	 max_edges < graph->n_edges + n_edges; max_edges *= 2);
+
+    if (max_edges > (size_t) -1 / sizeof(IDX_EDGE)
+	|| (edges = realloc(graph->edges,
+			    sizeof(IDX_EDGE) * max_edges)) == NULL)
+	return NCL_NO_MEMORY;
+
+    graph->edges = edges;
+    graph->max_edges = max_edges;
+    return NCL_OK;
+}
+
+/* check the range of an edge weight like the input of netindex */
+int NclCheckWeight(NCL_GRAPH * graph, float weight)
+{
+    if (weight != weight || weight < 0
+	|| (graph->weight_type && weight > 1))
+	return NCL_BAD_WEIGHT;
+
+    return NCL_OK;
+}
+
+/* add a batch of edges between node indices, either all or none */
+int NclAddEdges(NCL_GRAPH * graph, const unsigned int *nodes_a,
+		const unsigned int *nodes_b, const float *weights,
+		unsigned long long n_edges)
+{
+    unsigned long long i;
+    IDX_EDGE *edge;
+
+    for (i = 0; i < n_edges; i++) {
+	if (nodes_a[i] >= graph->dict->n_keys
+	    || nodes_b[i] >= graph->dict->n_keys)
+	    return NCL_BAD_NODE;
+	if (NclCheckWeight(graph, weights[i]))
+	    return NCL_BAD_WEIGHT;
+    }
+
+    if (NclReserveEdges(graph, n_edges))
+	return NCL_NO_MEMORY;
+
+    for (i = 0; i < n_edges; i++) {
+	edge = &graph->edges[graph->n_edges++];
+	edge->nodeA = nodes_a[i];
+	edge->nodeB = nodes_b[i];
+	edge->weight = weights[i];
+    }
+
+    return NCL_OK;
+}
+
+/*
+ * add a batch of edges between node labels; new labels are added to the
+ * dictionary. If out of memory, the edges before the failing one are kept.
+ */
+int NclAddLabeledEdges(NCL_GRAPH * graph, const char **labels_a,
+		       const char **labels_b, const float *weights,
+		       unsigned long long n_edges)
+{
+    unsigned long long i;
+    IDX_EDGE *edge;
+
+    for (i = 0; i < n_edges; i++)
+	if (NclCheckWeight(graph, weights[i]))
+	    return NCL_BAD_WEIGHT;
+
+    if (NclReserveEdges(graph, n_edges))
+	return NCL_NO_MEMORY;
+
+    for (i = 0; i < n_edges; i++) {
+	edge = &graph->edges[graph->n_edges];
+
+	if (NclAddNode(graph, labels_a[i], &edge->nodeA)
+	    || NclAddNode(graph, labels_b[i], &edge->nodeB))
+	    return NCL_NO_MEMORY;
+
+	edge->weight = weights[i];
+	graph->n_edges++;
+    }
+
+    return NCL_OK;
+}
+
+/* merge the edges passing a cutoff in several threads */
+int NclParallelUnion(NCL_GRAPH * graph, unsigned int *set,
+		     float weight_cutoff, unsigned int n_threads,
+		     unsigned long long *n_edges_passed)
+{
+    unsigned long long first, next;
+    unsigned int t, n_started;
+    int status;
+    pthread_t thread[MAX_THREADS];
+    UNION_TASK task[MAX_THREADS];
+    NCLS_IO_SET ioset;
+
+    ioset.weight_type = graph->weight_type;
+    ioset.weight_cutoff = weight_cutoff;
+    status = NCL_OK;
+
+    /* assign each thread a contiguous range of edges */
+    for (t = 0, first = 0, n_started = 0; t < n_threads; t++, first = next) {
+	next = graph->n_edges * (t + 1) / n_threads;
+	task[t].set = set;
+	task[t].pt_ioset = &ioset;
+	task[t].n_edges_passed = 0;
+	task[t].edges = graph->edges + first;
+	task[t].count = next - first;
+
+	if (pthread_create(&thread[t], NULL, UnionEdgeRange, &task[t])) {
+	    status = NCL_NO_THREAD;
+	    break;
+	}
+	n_started++;
+    }
+
+    /* wait for the started threads even if another one failed */
+    for (t = 0; t < n_started; t++) {
+	if (pthread_join(thread[t], NULL))
+	    status = NCL_NO_THREAD;
+	*n_edges_passed += task[t].n_edges_passed;
+    }
+
+    return status;
+}
+
+/* find the clusters of the edges passing a cutoff */
+int NclClusterGraph(NCL_GRAPH * graph, float weight_cutoff,
+		    unsigned int n_threads, PARTITION ** par,
+		    unsigned long long *n_edges_passed)
+{
+    unsigned long long n_passed;
+    unsigned int i, n_nodes, *set, *set_size;
+    int status;
+
+    *par = NULL;
+
+    if (weight_cutoff != weight_cutoff || weight_cutoff < 0
+	|| (graph->weight_type && weight_cutoff > 1)
+	|| n_threads < 1 || n_threads > MAX_THREADS)
+	return NCL_BAD_ARGUMENT;
+
+    /* allocate memory for union sets and set sizes */
+    n_nodes = graph->dict->n_keys;
+    set = malloc(sizeof(unsigned int) * (n_nodes ? n_nodes : 1));
+    set_size = malloc(sizeof(unsigned int) * (n_nodes ? n_nodes : 1));
+
+    if (set == NULL || set_size == NULL) {
+	free(set);
+	free(set_size);
+	return NCL_NO_MEMORY;
+    }
+
+    for (i = 0; i < n_nodes; i++) {
+	set[i] = i;
+	set_size[i] = 1;
+    }
+
+    /* merge the edges like GetGraphPartition does for an index */
+    n_passed = 0;
+    status = NCL_OK;
+
+    if (n_threads > 1)
+	status = NclParallelUnion(graph, set, weight_cutoff, n_threads,
+				  &n_passed);
+    else
+	n_passed = UnionEdges(set, set_size, graph->edges, graph->n_edges,
+			      graph->weight_type, weight_cutoff);
+    free(set_size);
+
+    if (status == NCL_OK
+	&& (*par = NewGraphPartition(n_nodes, set, NULL)) == NULL)
+	status = NCL_NO_MEMORY;
+    free(set);
+
+    if (n_edges_passed != NULL)
+	*n_edges_passed = n_passed;
+
+    return status;
+}
+
+/* get the number of clusters (including singletons) */
+unsigned int NclNumClusters(PARTITION * par)
+{
+    return par->size;
+}
+
+/* get the node indices of the members of a cluster (or NULL) */
+const unsigned int *NclClusterMembers(PARTITION * par, unsigned int cluster,
+				      unsigned int *size)
+{
+    if (cluster >= par->size) {
+	*size = 0;
+	return NULL;
+    }
+
+    *size = par->cluster[cluster].size;
+    return par->cluster[cluster].member;
+}
+
+/* release memory of a partition */
+void NclFreePartition(PARTITION * par)
+{
+    if (par != NULL)
+	FreeGraphPartition(par);
+}
+
+/* get the message of a status code */
+const char *NclStatusMessage(int status)
+{
+    switch (status) {
+    case NCL_OK:
+	return "Success";
+    case NCL_NO_MEMORY:
+	return "Out of memory";
+    case NCL_BAD_NODE:
+	return "Unknown node";
+    case NCL_BAD_WEIGHT:
+	return "Edge weight out of range";
+    case NCL_BAD_ARGUMENT:
+	return "Invalid argument";
+    case NCL_NO_THREAD:
+	return "Thread cannot be created";
+    }
+    return "Unknown status";
+}
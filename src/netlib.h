@@ -0,0 +1,82 @@
+/*
+ * File:	netlib.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETLIB_H
+#define	NETLIB_H
+
+#include "net.h"
+#include <stdio.h>
+#include "netio.h"
+#include "nethash.h"
+#include "netclust.h"
+
+/* status codes of the library calls (no call exits the process) */
+#define NCL_OK 0		/* success */
+#define NCL_NO_MEMORY 1		/* out of memory */
+#define NCL_BAD_NODE 2		/* unknown node label or index */
+#define NCL_BAD_WEIGHT 3	/* edge weight out of range of the weight type */
+#define NCL_BAD_ARGUMENT 4	/* invalid argument */
+#define NCL_NO_THREAD 5		/* thread cannot be created */
+
+#define NCL_EDGES 1024		/* initial number of edges of a graph */
+
+/* typedefs */
+typedef struct _ncl_graph_ NCL_GRAPH;	/* graph held in memory */
+
+/* type declarations */
+struct _ncl_graph_ {
+    unsigned int weight_type;	/* weight type for edges (0 - S, 1 - D) */
+    HASH_TABLE *dict;		/* dictionary of node labels */
+    IDX_EDGE *edges;		/* edges of node indices */
+    unsigned long long n_edges;	/* number of edges */
+    unsigned long long max_edges;	/* allocated number of edges */
+};
+
+/* function prototypes */
+extern int NclNewGraph(NCL_GRAPH **, unsigned int);
+extern void NclFreeGraph(NCL_GRAPH *);
+extern int NclAddNode(NCL_GRAPH *, const char *, unsigned int *);
+extern int NclFindNode(NCL_GRAPH *, const char *, unsigned int *);
+extern const char *NclNodeLabel(NCL_GRAPH *, unsigned int);
+extern unsigned int NclNumNodes(NCL_GRAPH *);
+extern unsigned long long NclNumEdges(NCL_GRAPH *);
+extern int NclReserveEdges(NCL_GRAPH *, unsigned long long);
+extern int NclCheckWeight(NCL_GRAPH *, float);
+extern int NclAddEdges(NCL_GRAPH *, const unsigned int *,
+		       const unsigned int *, const float *,
+		       unsigned long long);
+extern int NclAddLabeledEdges(NCL_GRAPH *, const char **, const char **,
+			      const float *, unsigned long long);
+extern int NclParallelUnion(NCL_GRAPH *, unsigned int *, float,
+			    unsigned int, unsigned long long *);
+extern int NclClusterGraph(NCL_GRAPH *, float, unsigned int,
+			   PARTITION **, unsigned long long *);
+extern unsigned int NclNumClusters(PARTITION *);
+extern const unsigned int *NclClusterMembers(PARTITION *, unsigned int,
+					     unsigned int *);
+extern void NclFreePartition(PARTITION *);
+extern const char *NclStatusMessage(int);
+
+#endif				/* NETLIB_H */
@@ -0,0 +1,597 @@
+/*
+ * File:	netparse.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Parsing of edge lists in the [nodeA] [nodeB] [weight] text format.
+ *
+ * The input is read in large blocks of whole lines, which are split into
+ * newline-aligned chunks and tokenized in place by several threads. Node
+ * labels of the parsed edges point into the text block. A reader thread may
+ * read the next blocks while a block is parsed (StartTextReader).
+ *
+ * Fields & lines are delimited by masks of the white space in windows of 64
+ * bytes (built 16 bytes at a time with SSE2), and weights are parsed by an
+ * exact fast path for short decimals, falling back to strtof().
+ * Compiled with -DPARSE_CHECK, every parsed line is compared with the result
+ * of sscanf() and a mismatch stops the program.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "netparse.h"
+
+/* powers of ten exact in single precision (5^10 < 2^24) */
+const float ParsePow10[PARSE_MAX_EXP + 1] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+/* open a text file for reading in blocks of whole lines */
+TEXT_READER *OpenTextReader(char *file_name)
+{
+    TEXT_READER *reader;
+
+    MALLOC(reader, sizeof(TEXT_READER));
+
+    /* read the standard input for the file name "-" */
+    if (!strcmp(file_name, "-"))
+	reader->fp = stdin;
+    else
+	FOPEN(reader->fp, file_name, "rb");
+    reader->file_name = file_name;
+    reader->size = 0;
+    reader->used = 0;
+    reader->threaded = 0;
+    reader->eof = 0;
+    reader->current = NULL;
+
+    /* reserve one byte to terminate the last line */
+    MALLOC(reader->buf, TEXT_BLOCK + 1);
+
+    return reader;
+}
+
+/* read the blocks of a text file ahead by a thread */
+void StartTextReader(TEXT_READER * reader)
+{
+    unsigned int i;
+
+    InitBlockQueue(&reader->full);
+    InitBlockQueue(&reader->empty);
+
+    /* the buffer of the reader is the first one of the thread */
+    reader->buffers[0].buf = reader->buf;
+    for (i = 1; i < TEXT_QUEUE; i++)
+	MALLOC(reader->buffers[i].buf, TEXT_BLOCK + 1);
+    for (i = 0; i < TEXT_QUEUE; i++)
+	PushBlock(&reader->empty, &reader->buffers[i]);
+
+    reader->threaded = 1;
+    if (pthread_create(&reader->thread, NULL, ReadTextAhead, reader))
+	OOPS("Error: pthread_create()\n");
+}
+
+/* read blocks of whole lines into the queue, NULL ends it (thread routine) */
+void *ReadTextAhead(void *pt_arg)
+{
+    size_t n;
+    char *end;
+    TEXT_READER *reader;
+    TEXT_BUFFER *block, *next;
+
+    reader = (TEXT_READER *) pt_arg;
+    block = (TEXT_BUFFER *) PopBlock(&reader->empty);
+    block->size = 0;
+
+    for (;;) {
+	n = fread(block->buf + block->size, 1, TEXT_BLOCK - block->size,
+		  reader->fp);
+	if (ferror(reader->fp))
+	    OOPS(reader->file_name);
+	block->size += n;
+
+	/* the last block ends at the end of file */
+	if (n == 0 || feof(reader->fp)) {
+	    if (block->size)
+		PushBlock(&reader->full, block);
+	    PushBlock(&reader->full, NULL);
+	    return NULL;
+	}
+
+	for (end = block->buf + block->size; end != block->buf; end--)
+	    if (end[-1] == '\n')
+		break;
+
+	if (end == block->buf) {
+	    fprintf(stderr, "Error: Line longer than %d bytes in %s.\n",
+		    TEXT_BLOCK, reader->file_name);
+	    exit(EXIT_FAILURE);
+	}
+
+	/* start the next block with the incomplete line */
+	next = (TEXT_BUFFER *) PopBlock(&reader->empty);
+	next->size = block->buf + block->size - end;
+	memcpy(next->buf, end, next->size);
+	block->size = end - block->buf;
+
+	PushBlock(&reader->full, block);
+	block = next;
+    }
+}
+
+/* get the next block of whole lines, returns zero at the end of file */
+size_t ReadTextBlock(TEXT_READER * reader, char **text)
+{
+    size_t n;
+    char *end;
+
+    /* take a block read ahead, the last one is free for reading again */
+    if (reader->threaded) {
+	if (reader->current != NULL)
+	    PushBlock(&reader->empty, reader->current);
+	reader->current = NULL;
+
+	if (reader->eof
+	    || (reader->current =
+		(TEXT_BUFFER *) PopBlock(&reader->full)) == NULL) {
+	    reader->eof = 1;
+	    return 0;
+	}
+
+	*text = reader->current->buf;
+	return reader->current->size;
+    }
+
+    /* keep the incomplete line left from the last block */
+    reader->size -= reader->used;
+    memmove(reader->buf, reader->buf + reader->used, reader->size);
+
+    n = fread(reader->buf + reader->size, 1, TEXT_BLOCK - reader->size,
+	      reader->fp);
+    if (ferror(reader->fp))
+	OOPS(reader->file_name);
+    reader->size += n;
+
+    /* cut the block after the last newline unless at the end of file */
+    if (n == 0 || feof(reader->fp))
+	reader->used = reader->size;
+    else {
+	for (end = reader->buf + reader->size; end != reader->buf; end--)
+	    if (end[-1] == '\n')
+		break;
+
+	if (end == reader->buf) {
+	    fprintf(stderr, "Error: Line longer than %d bytes in %s.\n",
+		    TEXT_BLOCK, reader->file_name);
+	    exit(EXIT_FAILURE);
+	}
+	reader->used = end - reader->buf;
+    }
+
+    *text = reader->buf;
+    return reader->used;
+}
+
+/* close a text file */
+void CloseTextReader(TEXT_READER * reader)
+{
+    unsigned int i;
+    char *text;
+
+    /* the reader thread ends after the last block */
+    if (reader->threaded) {
+	while (ReadTextBlock(reader, &text));
+	if (pthread_join(reader->thread, NULL))
+	    OOPS("Error: pthread_join()\n");
+
+	for (i = 1; i < TEXT_QUEUE; i++)
+	    free(reader->buffers[i].buf);
+	FreeBlockQueue(&reader->full);
+	FreeBlockQueue(&reader->empty);
+    }
+
+    FCLOSE(reader->fp, reader->file_name);
+    free(reader->buf);
+    free(reader);
+}
+
+/* split a block of lines into newline-aligned chunks */
+unsigned int SplitTextBlock(char *text, size_t size, TEXT_CHUNK * chunks,
+			    unsigned int n_chunks)
+{
+    unsigned int i;
+    char *start, *end, *stop;
+
+    stop = text + size;
+
+    for (i = 0, start = text; i < n_chunks && start != stop; i++) {
+	/* move the end of an equal share to the end of its line */
+	end = start + (stop - start) / (n_chunks - i);
+	while (end != stop && end != start && end[-1] != '\n')
+	    end++;
+	if (end == start)
+	    end = stop;
+
+	chunks[i].text = start;
+	chunks[i].size = end - start;
+	start = end;
+    }
+    return i;
+}
+
+/* get a mask of the bytes up to ' ' in a window of text, bit i for p[i] */
+unsigned long long MaskTextWindow(char *p, char *end)
+{
+    unsigned long long mask;
+    unsigned int i;
+#ifdef __SSE2__
+    __m128i bytes, bound;
+
+    /* a byte is up to ' ' if min(byte, ' ') == byte (unsigned) */
+    if (end - p >= PARSE_WINDOW) {
+	bound = _mm_set1_epi8(' ');
+	for (mask = 0, i = 0; i < PARSE_WINDOW; i += 16) {
+	    bytes = _mm_loadu_si128((__m128i *) (p + i));
+	    mask |= (unsigned long long)
+		_mm_movemask_epi8(_mm_cmpeq_epi8
+				  (_mm_min_epu8(bytes, bound), bytes)) << i;
+	}
+	return mask;
+    }
+#endif
+
+    for (mask = 0, i = 0; i < PARSE_WINDOW && p + i != end; i++)
+	if ((unsigned char) p[i] <= ' ')
+	    mask |= 1ULL << i;
+    return mask;
+}
+
+/* find the next white space (or the end of text) from a position */
+char *NextSpace(TEXT_SCAN * scan, char *p)
+{
+    unsigned long long mask;
+
+    for (;;) {
+	if (p >= scan->end)
+	    return scan->end;
+
+	/* move the window of the mask to the position */
+	if (p < scan->base || p - scan->base >= PARSE_WINDOW) {
+	    scan->base = p;
+	    scan->mask = MaskTextWindow(p, scan->end);
+	}
+
+	/* white space is among the bytes up to ' ' (isspace() of C locale) */
+	for (mask = scan->mask >> (p - scan->base); mask; mask &= mask - 1)
+	    if (isspace((unsigned char) p[__builtin_ctzll(mask)]))
+		return p + __builtin_ctzll(mask);
+
+	p = scan->base + PARSE_WINDOW;
+    }
+}
+
+/*
+ * Parse a weight like strtof(). The significant digits of a decimal with an
+ * optional exponent are collected into an integer m of at most 24 bits, so
+ * that m & 10^|e| are exact floats for |e| <= PARSE_MAX_EXP and a single
+ * multiplication or division rounds m * 10^e correctly. Trailing zeros are
+ * folded into the exponent. Any other number goes to strtof().
+ */
+float ParseWeight(char *str, char **str_end)
+{
+    unsigned long long m;
+    unsigned int n_zeros;
+    int exp, exp10, n_frac, neg, neg10;
+    char *p, *q;
+
+    p = str;
+    while (isspace((unsigned char) *p))
+	p++;
+
+    neg = *p == '-';
+    if (*p == '-' || *p == '+')
+	p++;
+
+    /* hexadecimal, infinity, NaN or no digits */
+    if (!IS_DIGIT(*p)
+	&& !(*p == '.' && IS_DIGIT(p[1])))
+	return strtof(str, str_end);
+    if (*p == '0' && (p[1] == 'x' || p[1] == 'X'))
+	return strtof(str, str_end);
+
+    m = 0;
+    n_zeros = 0;
+    n_frac = -1;
+    for (;; p++) {
+	if (*p == '.' && n_frac < 0) {
+	    n_frac = 0;
+	    continue;
+	}
+	if (!IS_DIGIT(*p))
+	    break;
+	if (n_frac >= 0)
+	    n_frac++;
+
+	/* keep zeros aside until a non-zero digit follows */
+	if (*p == '0') {
+	    n_zeros++;
+	    continue;
+	}
+	if (n_zeros > PARSE_MAX_DIGITS)
+	    return strtof(str, str_end);
+	for (; n_zeros; n_zeros--)
+	    m *= 10;
+	if ((m = 10 * m + (*p - '0')) > PARSE_MAX_MANTISSA)
+	    return strtof(str, str_end);
+    }
+    exp = n_zeros - (n_frac > 0 ? n_frac : 0);
+
+    /* the exponent is taken only if digits follow */
+    if (*p == 'e' || *p == 'E') {
+	q = p + 1;
+	neg10 = *q == '-';
+	if (*q == '-' || *q == '+')
+	    q++;
+	if (IS_DIGIT(*q)) {
+	    for (exp10 = 0; IS_DIGIT(*q); q++)
+		if (exp10 < 1000)
+		    exp10 = 10 * exp10 + (*q - '0');
+	    exp += neg10 ? -exp10 : exp10;
+	    p = q;
+	}
+    }
+
+    if (m && (exp < -PARSE_MAX_EXP || exp > PARSE_MAX_EXP))
+	return strtof(str, str_end);
+
+    *str_end = p;
+    if (!m)
+	return neg ? -0.0f : 0.0f;
+    if (exp < 0)
+	return neg ? -((float) m / ParsePow10[-exp]) :
+	    (float) m / ParsePow10[-exp];
+    return neg ? -((float) m * ParsePow10[exp]) :
+	(float) m * ParsePow10[exp];
+}
+
+/*
+ * Write a weight as printf("%f") does, returns the length. The float is
+ * m * 2^e with a 24-bit m, so that its value in millionths is an integer
+ * (e >= 0) or m * 10^6 / 2^-e, rounded half to even like printf() does in
+ * the default rounding mode. Other weights go to sprintf().
+ */
+unsigned int FormatFixedWeight(char *str, float weight)
+{
+    unsigned long long m, q, rem, half;
+    unsigned int n, shift;
+    int exp;
+    char digits[32];
+#ifdef PARSE_CHECK
+    char check[LINE_BUF];
+#endif
+    union {
+	float f;
+	unsigned int u;
+    } bits;
+
+    bits.f = weight;
+    exp = (bits.u >> 23) & 0xff;
+    m = bits.u & 0x7fffff;
+
+    if (exp == 0xff || exp - 150 > PARSE_MAX_SHIFT)
+	return sprintf(str, "%f", weight);
+
+    /* normal numbers have a hidden bit, subnormals the least exponent */
+    if (exp)
+	m |= 0x800000;
+    else
+	exp = 1;
+    exp -= 150;
+
+    /* millionths, values below 2^-45 round to zero */
+    if (exp >= 0)
+	q = (m << exp) * 1000000;
+    else if ((shift = -exp) < 64) {
+	m *= 1000000;
+	q = m >> shift;
+	rem = m & ((1ULL << shift) - 1);
+	half = 1ULL << (shift - 1);
+	if (rem > half || (rem == half && (q & 1)))
+	    q++;
+    } else
+	q = 0;
+
+    /* digits of the millionths, least significant first */
+    for (n = 0; q || n < 7; q /= 10) {
+	if (n == 6)
+	    digits[n++] = '.';
+	digits[n++] = '0' + q % 10;
+    }
+
+    str[0] = '-';
+    shift = bits.u >> 31;
+    while (n)
+	str[shift++] = digits[--n];
+    str[shift] = '\0';
+
+#ifdef PARSE_CHECK
+    sprintf(check, "%f", weight);
+    if (strcmp(str, check)) {
+	fprintf(stderr, "Error: weight %.9g written as %s, sprintf() %s\n",
+		weight, str, check);
+	exit(EXIT_FAILURE);
+    }
+#endif
+
+    return shift;
+}
+
+/* compare a parsed line with sscanf() (for -DPARSE_CHECK), frees the line */
+void CheckParsedLine(char *line, char *nodeA, char *nodeB, float weight)
+{
+    float check;
+    char *labelA, *labelB;
+
+    MALLOC(labelA, strlen(line) + 1);
+    MALLOC(labelB, strlen(line) + 1);
+
+    if (sscanf(line, "%s %s %f", labelA, labelB, &check) != 3
+	|| strcmp(labelA, nodeA) || strcmp(labelB, nodeB)
+	|| memcmp(&check, &weight, sizeof(float))) {
+	fprintf(stderr, "Error: line '%s' parsed as '%s' '%s' %.9g\n", line,
+		nodeA, nodeB, weight);
+	exit(EXIT_FAILURE);
+    }
+
+    free(labelA);
+    free(labelB);
+    free(line);
+}
+
+/* tokenize & filter the edges of a text chunk (thread routine) */
+void *ParseTextChunk(void *pt_arg)
+{
+    unsigned int weight_type;
+    float weight, weight_cutoff;
+    char *p, *line_end, *end, *nodeA, *nodeB, *str_weight, *str_end;
+    TEXT_CHUNK *chunk;
+    TEXT_SCAN scan;
+#ifdef PARSE_CHECK
+    char *line;
+#endif
+
+    chunk = (TEXT_CHUNK *) pt_arg;
+    weight_type = chunk->weight_type;
+    weight_cutoff = chunk->weight_cutoff;
+    chunk->n_lines = 0;
+    chunk->n_edges = 0;
+    chunk->status = PARSE_OK;
+    end = chunk->text + chunk->size;
+    scan.base = end;
+    scan.end = end;
+    scan.mask = 0;
+
+    for (p = chunk->text; p < end; p = line_end + 1) {
+#ifdef PARSE_CHECK
+	if ((line_end = memchr(p, '\n', end - p)) == NULL)
+	    line_end = end;
+	MALLOC(line, line_end - p + 1);
+	memcpy(line, p, line_end - p);
+	line[line_end - p] = '\0';
+#endif
+
+	/* split the line into [nodeA] [nodeB] [weight] columns */
+	while (p != end && *p != '\n' && isspace((unsigned char) *p))
+	    p++;
+	p = NextSpace(&scan, nodeA = p);
+	if (p == end || *p == '\n' || p == nodeA) {
+	    chunk->status = PARSE_FORMAT;
+	    return NULL;
+	}
+	*p++ = '\0';
+
+	while (p != end && *p != '\n' && isspace((unsigned char) *p))
+	    p++;
+	p = NextSpace(&scan, nodeB = p);
+	if (p == end || *p == '\n' || p == nodeB) {
+	    chunk->status = PARSE_FORMAT;
+	    return NULL;
+	}
+	*p++ = '\0';
+
+	/* the weight is the rest of the line */
+	for (line_end = NextSpace(&scan, p);
+	     line_end != end && *line_end != '\n';
+	     line_end = NextSpace(&scan, line_end + 1));
+	*line_end = '\0';
+	str_weight = p;
+	weight = ParseWeight(str_weight, &str_end);
+	if (str_end == str_weight) {
+	    chunk->status = PARSE_FORMAT;
+	    return NULL;
+	}
+#ifdef PARSE_CHECK
+	CheckParsedLine(line, nodeA, nodeB, weight);
+#endif
+
+	chunk->n_lines++;
+
+	/* filter edges depending on weight type */
+	if (weight_type) {	/* if distance values */
+	    if (weight > 1 || weight < 0) {
+		chunk->status = PARSE_RANGE;
+		return NULL;
+	    }
+	    if (weight > weight_cutoff)
+		continue;
+	} else {		/* if similarity values */
+	    if (weight < 0) {
+		chunk->status = PARSE_RANGE;
+		return NULL;
+	    }
+	    if (weight < weight_cutoff)
+		continue;
+	}
+
+	if (chunk->n_edges == chunk->max_edges) {
+	    chunk->max_edges = chunk->max_edges ? 2 * chunk->max_edges : 1024;
+	    if ((chunk->edges = realloc(chunk->edges,
+					sizeof(EDGE) * chunk->max_edges)) ==
+		NULL)
+		OOPS("Error: realloc()\n");
+	}
+	chunk->edges[chunk->n_edges].nodeA = nodeA;
+	chunk->edges[chunk->n_edges].nodeB = nodeB;
+	chunk->edges[chunk->n_edges].weight = weight;
+	chunk->n_edges++;
+    }
+
+    return NULL;
+}
+
+/* parse text chunks, one thread per chunk */
+void ParseTextChunks(TEXT_CHUNK * chunks, unsigned int n_chunks)
+{
+    unsigned int i;
+    pthread_t thread[MAX_THREADS];
+
+    if (n_chunks == 1) {
+	ParseTextChunk(&chunks[0]);
+	return;
+    }
+
+    for (i = 0; i < n_chunks; i++)
+	if (pthread_create(&thread[i], NULL, ParseTextChunk, &chunks[i]))
+	    OOPS("Error: pthread_create()\n");
+
+    for (i = 0; i < n_chunks; i++)
+	if (pthread_join(thread[i], NULL))
+	    OOPS("Error: pthread_join()\n");
+}
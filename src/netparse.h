@@ -0,0 +1,113 @@
+/*
+ * File:	netparse.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETPARSE_H
+#define	NETPARSE_H
+
+#define TEXT_BLOCK 67108864	/* bytes of input text read at once */
+#define TEXT_QUEUE 3		/* blocks of text of a reader thread */
+#define PARSE_WINDOW 64		/* bytes of text per mask of white space */
+#define PARSE_MAX_EXP 10	/* largest power of ten exact as a float */
+#define PARSE_MAX_DIGITS 8	/* zeros kept aside by the weight fast path */
+#define PARSE_MAX_MANTISSA 16777216	/* largest mantissa exact as a float */
+#define PARSE_MAX_SHIFT 20	/* largest binary exponent written exactly */
+#define IS_DIGIT(c) ((unsigned char) ((c) - '0') < 10)	/* isdigit() of the C locale */
+
+/* parsing status of a text chunk */
+#define PARSE_OK 0		/* all lines parsed */
+#define PARSE_FORMAT 1		/* line not in [nodeA] [nodeB] [weight] format */
+#define PARSE_RANGE 2		/* edge weight out of range for its type */
+
+/* typedefs */
+typedef struct _text_reader_ TEXT_READER;	/* reader of newline-aligned text */
+typedef struct _text_buffer_ TEXT_BUFFER;	/* block of text read ahead */
+typedef struct _text_chunk_ TEXT_CHUNK;	/* chunk of edge list text */
+typedef struct _text_scan_ TEXT_SCAN;	/* white space mask of a text window */
+
+/* type declarations */
+struct _text_buffer_ {
+    char *buf;			/* text of whole lines */
+    size_t size;		/* bytes of text in the buffer */
+};
+
+/*
+ * Once started, a reader thread reads the blocks ahead of the parser: it
+ * cuts each block after its last newline, moves the rest into the next empty
+ * buffer & queues the block. A block read by the parser returns to the empty
+ * buffers on its next read.
+ */
+struct _text_reader_ {
+    char *file_name;		/* input file */
+    FILE *fp;			/* input stream */
+    char *buf;			/* text buffer */
+    size_t size;		/* bytes of text in the buffer */
+    size_t used;		/* bytes of text returned by the last read */
+    unsigned int threaded;	/* 1 if the blocks are read by a thread */
+    unsigned int eof;		/* 1 if the last block has been read */
+    TEXT_BUFFER buffers[TEXT_QUEUE];	/* blocks of the reader thread */
+    TEXT_BUFFER *current;	/* block returned by the last read */
+    BLOCK_QUEUE full;		/* blocks read ahead */
+    BLOCK_QUEUE empty;		/* blocks free for reading */
+    pthread_t thread;		/* reader thread */
+};
+
+struct _text_chunk_ {
+    char *text;			/* text of whole lines */
+    size_t size;		/* size of the text */
+    unsigned int weight_type;	/* 0 - similarity, 1 - distance */
+    float weight_cutoff;	/* cutoff value for edge weights */
+    unsigned int n_lines;	/* number of edges read */
+    unsigned int n_edges;	/* number of edges passing the cutoff */
+    unsigned int max_edges;	/* allocated number of edges */
+    EDGE *edges;		/* edges passing the cutoff */
+    int status;			/* parsing status */
+};
+
+struct _text_scan_ {
+    char *base;			/* start of the window */
+    char *end;			/* end of the text */
+    unsigned long long mask;	/* bytes up to ' ' in the window */
+};
+
+/* global variables */
+extern const float ParsePow10[];
+
+/* function prototypes */
+extern TEXT_READER *OpenTextReader(char *);
+extern void StartTextReader(TEXT_READER *);
+extern void *ReadTextAhead(void *);
+extern size_t ReadTextBlock(TEXT_READER *, char **);
+extern void CloseTextReader(TEXT_READER *);
+extern unsigned int SplitTextBlock(char *, size_t, TEXT_CHUNK *,
+				   unsigned int);
+extern unsigned long long MaskTextWindow(char *, char *);
+extern char *NextSpace(TEXT_SCAN *, char *);
+extern float ParseWeight(char *, char **);
+extern unsigned int FormatFixedWeight(char *, float);
+extern void CheckParsedLine(char *, char *, char *, float);
+extern void *ParseTextChunk(void *);
+extern void ParseTextChunks(TEXT_CHUNK *, unsigned int);
+
+#endif				/* NETPARSE_H */
@@ -0,0 +1,396 @@
+/*
+ * File:	netserve.c
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ ****************************************************************************
+ *
+ * Query server of a resident graph (netclust -d SOCKET).
+ *
+ * The node & edge indices are loaded once; the partitions of the recently
+ * used cutoffs are cached. A partition is computed outside the lock of the
+ * cache, so that queries of other cutoffs are answered meanwhile. Clients
+ * send one query per line over a Unix domain socket & get one line back,
+ * either "OK ..." or "ERROR message":
+ *
+ *   COUNT [CUTOFF]                -> OK [number of clusters]
+ *   CLUSTER [CUTOFF] [NODE]       -> OK [cluster] [cluster size]
+ *   MEMBERS [CUTOFF] [CLUSTER]    -> OK [cluster size] [members]
+ *
+ * Clusters are numbered as in the output of netclust (by size) & singletons
+ * are not counted, but a node without edges is reported in its own cluster.
+ */
+
+#include "net.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "netio.h"
+#include "nethash.h"
+#include "netclust.h"
+#include "netserve.h"
+
+/* set by a signal to stop accepting clients */
+volatile sig_atomic_t stop_server = 0;
+
+/* load the node labels & keep all edges of the index in memory */
+void OpenClusterServer(NCLS_SERVER * server, NIDX_TABLE * table,
+		       NCLS_IO_SET * pt_ioset)
+{
+    unsigned long long n, max_edges;
+    unsigned int i, is_new;
+    IDX_EDGE *edges;
+    EIDX_READER *reader;
+
+    memset(server, 0, sizeof(NCLS_SERVER));
+    server->pt_ioset = pt_ioset;
+    server->table = table;
+
+    /* node indices of the labels */
+    server->dict = NewHashTable(table->table_size > HASH_TABLE_SZ / 2 ?
+				2 * table->table_size : HASH_TABLE_SZ);
+    for (i = 0; i < table->table_size; i++)
+	AddHashKey(server->dict, NODE_LABEL(table, i), &is_new);
+
+    /* a mapping of IDX_EDGE records is used as it is */
+    reader = OpenEidxReader(pt_ioset->infile_eidx);
+    if (reader->map != NULL && !reader->decode) {
+	server->n_edges = ReadEidxBlock(reader, &server->edges);
+	server->reader = reader;
+    } else {
+	/* decode other layouts once */
+	max_edges = reader->n_edges ? reader->n_edges : 1;
+	MALLOC(server->edges, sizeof(IDX_EDGE) * max_edges);
+
+	while ((n = ReadEidxBlock(reader, &edges)) != 0) {
+	    if (server->n_edges + n > max_edges)
+		ExitIndexError(pt_ioset->infile_eidx, "is corrupted.");
+	    memcpy(server->edges + server->n_edges, edges,
+		   sizeof(IDX_EDGE) * n);
+	    server->n_edges += n;
+	}
+	CloseEidxReader(reader);
+    }
+
+    if (pthread_mutex_init(&server->lock, NULL))
+	OOPS("Error: pthread_mutex_init()\n");
+    if (pthread_cond_init(&server->changed, NULL))
+	OOPS("Error: pthread_cond_init()\n");
+}
+
+/*
+ * get the partition of a cutoff, computing it if not cached; the partition is
+ * kept in the cache until it is released
+ */
+CACHED_PARTITION *GetCachedPartition(NCLS_SERVER * server,
+				     float weight_cutoff)
+{
+    unsigned int i, j, n_nodes, *set, *set_size;
+    CACHED_PARTITION *slot;
+    PARTITION *par;
+
+    pthread_mutex_lock(&server->lock);
+
+    /*
+     * Look up the cutoff or the least recently used slot that no query reads;
+     * wait for a partition being computed, or for a slot if all are in use.
+     */
+    for (;;) {
+	for (i = 0, slot = NULL; i < NSRV_CACHE; i++) {
+	    if (server->cache[i].used
+		&& server->cache[i].weight_cutoff == weight_cutoff)
+		break;
+	    if (!server->cache[i].users
+		&& (slot == NULL || server->cache[i].used < slot->used))
+		slot = &server->cache[i];
+	}
+
+	if (i < NSRV_CACHE && server->cache[i].ready) {
+	    server->cache[i].used = ++server->clock;
+	    server->cache[i].users++;
+	    pthread_mutex_unlock(&server->lock);
+	    return &server->cache[i];
+	}
+
+	if (i == NSRV_CACHE && slot != NULL)
+	    break;
+	pthread_cond_wait(&server->changed, &server->lock);
+    }
+
+    /* evict the partition of the slot */
+    if (slot->used) {
+	FreeGraphPartition(slot->par);
+	free(slot->node_cluster);
+    }
+
+    /* queries of the same cutoff wait until the partition is ready */
+    slot->weight_cutoff = weight_cutoff;
+    slot->used = ++server->clock;
+    slot->ready = 0;
+    slot->users = 1;
+    pthread_mutex_unlock(&server->lock);
+
+    /* merge the resident edges passing the cutoff */
+    n_nodes = server->table->table_size;
+    MALLOC(set, sizeof(unsigned int) * (n_nodes ? n_nodes : 1));
+    MALLOC(set_size, sizeof(unsigned int) * (n_nodes ? n_nodes : 1));
+
+    for (i = 0; i < n_nodes; i++) {
+	set[i] = i;
+	set_size[i] = 1;
+    }
+
+    UnionEdges(set, set_size, server->edges, server->n_edges,
+	       server->pt_ioset->weight_type, weight_cutoff);
+    par = BuildGraphPartition(server->table, set, NULL);
+    free(set);
+    free(set_size);
+
+    /* map each node to its cluster */
+    MALLOC(slot->node_cluster,
+	   sizeof(unsigned int) * (n_nodes ? n_nodes : 1));
+    slot->n_clusters = 0;
+
+    for (i = 0; i < par->size; i++) {
+	if (par->cluster[i].size > 1)
+	    slot->n_clusters++;
+	for (j = 0; j < par->cluster[i].size; j++)
+	    slot->node_cluster[par->cluster[i].member[j]] = i;
+    }
+
+    pthread_mutex_lock(&server->lock);
+    slot->par = par;
+    slot->ready = 1;
+    pthread_cond_broadcast(&server->changed);
+    pthread_mutex_unlock(&server->lock);
+
+    return slot;
+}
+
+/* release a partition of the cache, so that it may be evicted */
+void ReleaseCachedPartition(NCLS_SERVER * server, CACHED_PARTITION * slot)
+{
+    pthread_mutex_lock(&server->lock);
+    if (--slot->users == 0)
+	pthread_cond_broadcast(&server->changed);
+    pthread_mutex_unlock(&server->lock);
+}
+
+/* answer a query line */
+void AnswerQuery(NCLS_SERVER * server, char *line, FILE * fp)
+{
+    unsigned int i, cluster, node, weight_type;
+    float weight_cutoff;
+    char command[16], *arg, *end;
+    CACHED_PARTITION *slot;
+    CLUSTER *cls;
+
+    weight_type = server->pt_ioset->weight_type;
+    line[strcspn(line, "\r\n")] = '\0';
+
+    /* parse the command & the cutoff */
+    if (sscanf(line, "%15s", command) != 1) {
+	fputs("ERROR Empty query\n", fp);
+	return;
+    }
+
+    arg = line + strspn(line, " \t") + strlen(command);
+    weight_cutoff = strtod(arg, &end);
+
+    if (end == arg || weight_cutoff < 0
+	|| (weight_cutoff > 1 && weight_type)) {
+	fputs("ERROR Cutoff missing or out of range\n", fp);
+	return;
+    }
+    arg = end + strspn(end, " \t");
+
+    if (!strcmp(command, "COUNT")) {
+	slot = GetCachedPartition(server, weight_cutoff);
+	fprintf(fp, "OK %u\n", slot->n_clusters);
+	ReleaseCachedPartition(server, slot);
+    } else if (!strcmp(command, "CLUSTER")) {
+	arg[strcspn(arg, " \t")] = '\0';
+	if (!GetHashValue(server->dict, arg, &node)) {
+	    fputs("ERROR Unknown node\n", fp);
+	    return;
+	}
+	slot = GetCachedPartition(server, weight_cutoff);
+	cluster = slot->node_cluster[node];
+	fprintf(fp, "OK %u %u\n", cluster + 1,
+		slot->par->cluster[cluster].size);
+	ReleaseCachedPartition(server, slot);
+    } else if (!strcmp(command, "MEMBERS")) {
+	cluster = strtoul(arg, &end, 10);
+	slot = GetCachedPartition(server, weight_cutoff);
+
+	if (end == arg || cluster < 1 || cluster > slot->par->size) {
+	    ReleaseCachedPartition(server, slot);
+	    fputs("ERROR Unknown cluster\n", fp);
+	    return;
+	}
+	cls = &slot->par->cluster[cluster - 1];
+
+	fprintf(fp, "OK %u", cls->size);
+	for (i = 0; i < cls->size; i++)
+	    fprintf(fp, " %s", NODE_LABEL(server->table, cls->member[i]));
+	fputc('\n', fp);
+	ReleaseCachedPartition(server, slot);
+    } else
+	fputs("ERROR Unknown command\n", fp);
+}
+
+/* answer the queries of a client until it disconnects (thread routine) */
+void *ServeClient(void *pt_arg)
+{
+    char line[NSRV_LINE];
+    NCLS_CLIENT *client;
+    FILE *fp_in, *fp_out;
+    int fd;
+
+    client = (NCLS_CLIENT *) pt_arg;
+
+    /* separate streams for reading & writing the socket */
+    if ((fd = dup(client->fd)) < 0
+	|| (fp_in = fdopen(client->fd, "r")) == NULL
+	|| (fp_out = fdopen(fd, "w")) == NULL) {
+	perror("Error: fdopen()");
+	close(client->fd);
+	free(client);
+	return NULL;
+    }
+
+    /* the queries of several clients are answered at the same time */
+    while (fgets(line, NSRV_LINE, fp_in) != NULL) {
+	AnswerQuery(client->server, line, fp_out);
+
+	if (fflush(fp_out))
+	    break;
+    }
+
+    fclose(fp_in);
+    fclose(fp_out);
+    free(client);
+    return NULL;
+}
+
+/* stop accepting clients (signal handler) */
+void StopClusterServer(int sig)
+{
+    (void) sig;
+    stop_server = 1;
+}
+
+/* answer queries over a Unix domain socket until interrupted */
+void RunClusterServer(NIDX_TABLE * table, NCLS_IO_SET * pt_ioset)
+{
+    int fd, client_fd, probe, stale;
+    struct sockaddr_un addr;
+    struct sigaction action;
+    sigset_t signals, old_signals;
+    pthread_t thread;
+    pthread_attr_t attr;
+    NCLS_SERVER server;
+    NCLS_CLIENT *client;
+
+    OpenClusterServer(&server, table, pt_ioset);
+
+    if (strlen(pt_ioset->socket_file) >= sizeof(addr.sun_path)) {
+	fprintf(stderr, "Error: Socket path %s is too long.\n",
+		pt_ioset->socket_file);
+	exit(EXIT_FAILURE);
+    }
+
+    /* listen on the socket */
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, pt_ioset->socket_file);
+
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+	OOPS("Error: socket()");
+
+    /* replace the socket left by a server that is gone */
+    if (bind(fd, (struct sockaddr *) &addr, sizeof(addr))) {
+	if (errno != EADDRINUSE)
+	    OOPS(pt_ioset->socket_file);
+
+	probe = socket(AF_UNIX, SOCK_STREAM, 0);
+	stale = probe >= 0
+	    && connect(probe, (struct sockaddr *) &addr, sizeof(addr))
+	    && errno == ECONNREFUSED;
+	if (probe >= 0)
+	    close(probe);
+
+	if (!stale || unlink(pt_ioset->socket_file)
+	    || bind(fd, (struct sockaddr *) &addr, sizeof(addr)))
+	    OOPS(pt_ioset->socket_file);
+    }
+
+    if (listen(fd, NSRV_BACKLOG))
+	OOPS(pt_ioset->socket_file);
+
+    /* stop on SIGINT & SIGTERM, ignore clients that hang up */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = StopClusterServer;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    /* the signals interrupt accept() of this thread only */
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+
+    fprintf(stderr, "netclust: serving %s on %s\n", pt_ioset->infile,
+	    pt_ioset->socket_file);
+
+    while (!stop_server) {
+	if ((client_fd = accept(fd, NULL, NULL)) < 0) {
+	    if (errno == EINTR || errno == ECONNABORTED)
+		continue;
+	    perror(pt_ioset->socket_file);
+	    break;
+	}
+
+	MALLOC(client, sizeof(NCLS_CLIENT));
+	client->server = &server;
+	client->fd = client_fd;
+
+	pthread_sigmask(SIG_BLOCK, &signals, &old_signals);
+	if (pthread_create(&thread, &attr, ServeClient, client)) {
+	    perror("Error: pthread_create()");
+	    close(client_fd);
+	    free(client);
+	}
+	pthread_sigmask(SIG_SETMASK, &old_signals, NULL);
+    }
+
+    /* remove the socket (the clients are dropped on exit) */
+    close(fd);
+    unlink(pt_ioset->socket_file);
+}
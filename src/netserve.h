@@ -0,0 +1,76 @@
+/*
+ * File:	netserve.h
+ * Author:	Arnold Kuzniar
+ * Date:	29-04-2008
+ * Version:	1.0
+ *
+ ***************************************************************************
+ * Copyright 2008 Arnold Kuzniar
+ *
+ * This file is part of netclust/netindex.
+ *
+ * netclust/netindex is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * netclust/netindex is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser Public License
+ * along with netclust/netindex.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NETSERVE_H
+#define	NETSERVE_H
+
+#define NSRV_CACHE 8		/* partitions cached for the recently used cutoffs */
+#define NSRV_LINE 4096		/* maximum length of a query line */
+#define NSRV_BACKLOG 64		/* pending connections of the socket */
+
+/* typedefs */
+typedef struct _cached_partition_ CACHED_PARTITION;	/* partition of a cutoff */
+typedef struct _ncls_server_ NCLS_SERVER;	/* resident graph & cache */
+typedef struct _ncls_client_ NCLS_CLIENT;	/* connection of a client */
+
+/* type declarations */
+struct _cached_partition_ {
+    float weight_cutoff;	/* cutoff of the partition */
+    unsigned long long used;	/* time of the last query (0 - empty) */
+    unsigned int ready;		/* 0 while the partition is computed */
+    unsigned int users;		/* queries reading the partition */
+    unsigned int n_clusters;	/* number of non-singleton clusters */
+    unsigned int *node_cluster;	/* cluster of each node */
+    PARTITION *par;		/* clusters sorted by size */
+};
+
+struct _ncls_server_ {
+    NCLS_IO_SET *pt_ioset;	/* IO settings */
+    NIDX_TABLE *table;		/* lookup table of node labels */
+    HASH_TABLE *dict;		/* node indices of the labels */
+    EIDX_READER *reader;	/* mapped index of resident edges (or NULL) */
+    IDX_EDGE *edges;		/* resident edges */
+    unsigned long long n_edges;	/* number of resident edges */
+    unsigned long long clock;	/* number of queries answered */
+    CACHED_PARTITION cache[NSRV_CACHE];	/* partitions of recent cutoffs */
+    pthread_mutex_t lock;	/* guards the cache (not the partitions) */
+    pthread_cond_t changed;	/* a partition is ready or no longer used */
+};
+
+struct _ncls_client_ {
+    NCLS_SERVER *server;	/* server answering the queries */
+    int fd;			/* connected socket */
+};
+
+/* function prototypes */
+extern void OpenClusterServer(NCLS_SERVER *, NIDX_TABLE *, NCLS_IO_SET *);
+extern CACHED_PARTITION *GetCachedPartition(NCLS_SERVER *, float);
+extern void ReleaseCachedPartition(NCLS_SERVER *, CACHED_PARTITION *);
+extern void AnswerQuery(NCLS_SERVER *, char *, FILE *);
+extern void *ServeClient(void *);
+extern void StopClusterServer(int);
+extern void RunClusterServer(NIDX_TABLE *, NCLS_IO_SET *);
+
+#endif				/* NETSERVE_H */